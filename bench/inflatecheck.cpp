@@ -0,0 +1,187 @@
+/************************************************************************/
+/* Regression checks for the inflater that need streams zlib and the    */
+/* component's own compressor never produce, so they are encoded here   */
+/* by hand. Exits with 1 and a message if a check fails.                */
+/*                                                                      */
+/*   inflatecheck                                                       */
+/************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "crc32.h"
+#include "inflate.h"
+
+using namespace runtime::doo::zip::core;
+
+/************************************************************************/
+/* A single final block with the fixed Huffman codes of RFC 1951, which */
+/* is enough to place literals and matches exactly. The output it       */
+/* stands for is kept alongside.                                        */
+/************************************************************************/
+class FixedBlockWriter {
+public:
+  FixedBlockWriter() : bitBuffer(0), bitCount(0) {
+    PutBits(1, 1);
+    PutBits(1, 2);
+  }
+
+  void Literal(uint8_t value) {
+    if (value < 144) {
+      PutCode(0x30 + value, 8);
+    } else {
+      PutCode(0x190 + value - 144, 9);
+    }
+    output.push_back(value);
+  }
+
+  // length 3 to 258, distance 1 to 32768
+  void Match(unsigned int length, unsigned int distance) {
+    static const unsigned int lengthBase[] = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const unsigned int lengthExtra[] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const unsigned int distanceBase[] = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const unsigned int distanceExtra[] = {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    unsigned int lengthCode = 28;
+    while (lengthBase[lengthCode] > length) {
+      lengthCode--;
+    }
+    unsigned int symbol = 257 + lengthCode;
+    if (symbol < 280) {
+      PutCode(symbol - 256, 7);
+    } else {
+      PutCode(0xC0 + symbol - 280, 8);
+    }
+    PutBits(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+    unsigned int distanceCode = 29;
+    while (distanceBase[distanceCode] > distance) {
+      distanceCode--;
+    }
+    PutCode(distanceCode, 5);
+    PutBits(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+    for (unsigned int i = 0; i < length; i++) {
+      output.push_back(output[output.size() - distance]);
+    }
+  }
+
+  void Finish() {
+    PutCode(0, 7);
+    if (bitCount > 0) {
+      stream.push_back(static_cast<uint8_t>(bitBuffer));
+    }
+  }
+
+  std::vector<uint8_t> stream;
+  std::vector<uint8_t> output;
+
+private:
+  // Huffman codes go out most significant bit first
+  void PutCode(unsigned int code, unsigned int length) {
+    unsigned int reversed = 0;
+    for (unsigned int i = 0; i < length; i++) {
+      reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    PutBits(reversed, length);
+  }
+
+  void PutBits(unsigned int value, unsigned int count) {
+    bitBuffer |= value << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+      stream.push_back(static_cast<uint8_t>(bitBuffer));
+      bitBuffer >>= 8;
+      bitCount -= 8;
+    }
+  }
+
+  uint32_t bitBuffer;
+  unsigned int bitCount;
+};
+
+static bool failed = false;
+
+static void check(bool condition, const char* message) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", message);
+    failed = true;
+  }
+}
+
+// inflate the whole stream through the 32 KB dictionary, handing the input over in pieces
+static std::vector<uint8_t> inflateWithDictionary(const std::vector<uint8_t>& stream, size_t pieceSize,
+                                                  uint32_t* crc) {
+  Inflater inflater;
+  std::vector<uint8_t> output;
+  size_t position = 0;
+  tinfl_status status;
+  do {
+    size_t inputSize = std::min(pieceSize, stream.size() - position);
+    bool hasMoreInput = position + inputSize < stream.size();
+    const uint8_t* piece;
+    size_t pieceLength;
+    status = inflater.Inflate(stream.data() + position, &inputSize, hasMoreInput, &piece, &pieceLength);
+    position += inputSize;
+    output.insert(output.end(), piece, piece + pieceLength);
+  } while (status == TINFL_STATUS_HAS_MORE_OUTPUT || status == TINFL_STATUS_NEEDS_MORE_INPUT);
+  check(status == TINFL_STATUS_DONE, "stream didn't inflate completely");
+  *crc = inflater.Crc32();
+  return output;
+}
+
+/************************************************************************/
+/* Matches reaching back almost the whole window right after short      */
+/* ones and after single literals. In the wrapping dictionary the bytes */
+/* just past the output still hold the history those matches read, so   */
+/* nothing may be written beyond the end of a match or literal.         */
+/************************************************************************/
+static void checkFarMatches() {
+  FixedBlockWriter block;
+  uint32_t seed = 1;
+  for (int i = 0; i < 32768; i++) {
+    seed = seed * 1103515245 + 12345;
+    block.Literal(static_cast<uint8_t>(seed >> 16));
+  }
+  for (int i = 0; i < 4000; i++) {
+    seed = seed * 1103515245 + 12345;
+    block.Match(20 + i % 40, 100);
+    block.Match(20 + i % 17, 32766);
+    block.Literal(static_cast<uint8_t>(seed >> 16));
+    block.Match(3 + i % 30, 32768);
+    block.Match(8 + i % 9, 16 + i % 50);
+    block.Match(30, 32760 + i % 9);
+  }
+  block.Finish();
+  uint32_t expectedCrc = updateCrc32(0, block.output.data(), block.output.size());
+
+  const size_t pieceSizes[] = { 1, 7, 4096, block.stream.size() };
+  for (size_t i = 0; i < sizeof(pieceSizes) / sizeof(pieceSizes[0]); i++) {
+    uint32_t crc;
+    std::vector<uint8_t> output = inflateWithDictionary(block.stream, pieceSizes[i], &crc);
+    check(output == block.output, "far matches inflate differently through the dictionary");
+    check(crc == expectedCrc, "far matches give the wrong CRC-32 through the dictionary");
+  }
+
+  std::vector<uint8_t> span(block.output.size());
+  uint32_t crc;
+  check(inflateToSpan(block.stream.data(), block.stream.size(), span.data(), span.size(), &crc) &&
+    span == block.output && crc == expectedCrc, "far matches inflate differently into a span");
+}
+
+int main() {
+  checkFarMatches();
+  if (failed) {
+    return 1;
+  }
+  fprintf(stderr, "all checks passed\n");
+  return 0;
+}
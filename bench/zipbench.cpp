@@ -0,0 +1,510 @@
+/************************************************************************/
+/* Benchmarks for the portable core: how fast central directories parse */
+/* into entries and the entry table, inflate and stored-copy throughput */
+/* and, through the memory-mapped backend, how fast archives open and   */
+/* extract to disk. Runs over the test resources and a generated        */
+/* corpus, and writes the results as JSON.                              */
+/*                                                                      */
+/* Only the parsers, EntryTable and Inflater are shared with the WinRT  */
+/* component. It opens and reads archives through its own stream code, */
+/* which isn't measured here, so the mapped_ metrics don't reflect it.  */
+/*                                                                      */
+/*   zipbench [--smoke] [--corpus DIR] [--resources DIR]                */
+/*            [--output FILE] [--repetitions N]                         */
+/*            [--tiny-entries N] [--large-size BYTES]                   */
+/*            [--random-size BYTES]                                     */
+/*                                                                      */
+/* The generated archives are kept in the corpus folder and reused by   */
+/* later runs. --smoke uses a small corpus and a single repetition.     */
+/************************************************************************/
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "entrytable.h"
+#include "mappedarchive.h"
+#include "zipformat.h"
+#include "zipwriter.h"
+
+using namespace runtime::doo::zip::core;
+
+// entries up to this size are inflated into memory, larger ones piece by piece
+#define BENCH_MAX_BUFFERED_ENTRY (64 * 1024 * 1024)
+
+struct Options {
+  std::string corpusDirectory;
+  std::string resourceDirectory;
+  std::string outputPath;
+  int repetitions;
+  size_t tinyEntryCount;
+  uint64_t largeEntrySize;
+  uint64_t randomSize;
+};
+
+struct Result {
+  std::string archive;
+  std::string metric;
+  std::string unit;
+  double value;
+};
+
+static double seconds() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool fileExists(const std::string& path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == 0;
+}
+
+static void makeDirectory(const std::string& path) {
+  if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error("Could not create directory " + path);
+  }
+}
+
+// create the folders leading up to path, remembering them for cleanup
+static void makeParentDirectories(const std::string& root,
+                                  const std::string& path,
+                                  std::vector<std::string>* created) {
+  for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+    std::string directory = root + "/" + path.substr(0, slash);
+    if (!fileExists(directory)) {
+      makeDirectory(directory);
+      created->push_back(directory);
+    }
+  }
+}
+
+// xorshift, so generated data is the same on every run
+class RandomBytes {
+public:
+  explicit RandomBytes(uint64_t seed) : state(seed) {
+  }
+
+  uint64_t Next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  void Fill(uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      data[i] = static_cast<uint8_t>(Next() >> 24);
+    }
+  }
+
+private:
+  uint64_t state;
+};
+
+// text-like data that compresses about 3:1, built from a small vocabulary
+static void fillText(RandomBytes& random, uint8_t* data, size_t length) {
+  static const char* const words[] = {
+    "archive ", "entry ", "central ", "directory ", "inflate ", "deflate ", "stream ",
+    "buffer ", "offset ", "<w:p>", "</w:p>", "<text:span>", "\n", "header ", "42 ", "data "
+  };
+  size_t position = 0;
+  while (position < length) {
+    const char* word = words[random.Next() % (sizeof(words) / sizeof(words[0]))];
+    size_t wordLength = std::min(strlen(word), length - position);
+    memcpy(data + position, word, wordLength);
+    position += wordLength;
+  }
+}
+
+/************************************************************************/
+/* Corpus generation                                                    */
+/************************************************************************/
+static void writeArchive(const std::string& path, const std::function<void(ZipWriter&)>& addEntries) {
+  std::string partialPath = path + ".partial";
+  FILE* file = fopen(partialPath.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not create " + partialPath);
+  }
+  std::shared_ptr<FILE> out(file, fclose);
+  ZipWriter writer([&out, &partialPath](const uint8_t* data, size_t length) {
+    if (fwrite(data, 1, length, out.get()) != length) {
+      throw std::runtime_error("Could not write " + partialPath);
+    }
+  });
+  addEntries(writer);
+  writer.Finish();
+  out.reset();
+  if (rename(partialPath.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Could not create " + path);
+  }
+}
+
+static void addEntry(ZipWriter& writer, const std::string& filename, int level,
+                     uint64_t length, const std::function<void(uint8_t*, size_t)>& fill) {
+  writer.OpenEntry(filename.data(), filename.length(), level, 0, 0x21, length);
+  std::vector<uint8_t> chunk(static_cast<size_t>(std::min(length, (uint64_t)1024 * 1024)));
+  for (uint64_t written = 0; written < length; written += chunk.size()) {
+    size_t chunkLength = static_cast<size_t>(std::min((uint64_t)chunk.size(), length - written));
+    fill(chunk.data(), chunkLength);
+    writer.WriteEntryData(chunk.data(), chunkLength);
+  }
+  writer.CloseEntry();
+}
+
+// many tiny entries spread over folders, like an unpacked source tree
+static std::string tinyEntriesArchive(const Options& options) {
+  std::string path = options.corpusDirectory + "/tiny-" + std::to_string(options.tinyEntryCount) + ".zip";
+  if (!fileExists(path)) {
+    writeArchive(path, [&options](ZipWriter& writer) {
+      RandomBytes random(1);
+      for (size_t i = 0; i < options.tinyEntryCount; i++) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "folder%03zu/file%06zu.txt", i / 1000, i);
+        addEntry(writer, filename, 6, 20 + random.Next() % 200, [&random](uint8_t* data, size_t length) {
+          fillText(random, data, length);
+        });
+      }
+    });
+  }
+  return path;
+}
+
+// a single entry that is too large to be held in memory at once
+static std::string largeEntryArchive(const Options& options) {
+  std::string path = options.corpusDirectory + "/large-" + std::to_string(options.largeEntrySize) + ".zip";
+  if (!fileExists(path)) {
+    writeArchive(path, [&options](ZipWriter& writer) {
+      RandomBytes random(2);
+      addEntry(writer, "large.txt", 1, options.largeEntrySize, [&random](uint8_t* data, size_t length) {
+        fillText(random, data, length);
+      });
+    });
+  }
+  return path;
+}
+
+// incompressible data, once deflated and once stored
+static std::string randomDataArchive(const Options& options) {
+  std::string path = options.corpusDirectory + "/random-" + std::to_string(options.randomSize) + ".zip";
+  if (!fileExists(path)) {
+    writeArchive(path, [&options](ZipWriter& writer) {
+      RandomBytes deflatedRandom(3), storedRandom(3);
+      addEntry(writer, "random.deflated", 6, options.randomSize, [&deflatedRandom](uint8_t* data, size_t length) {
+        deflatedRandom.Fill(data, length);
+      });
+      addEntry(writer, "random.stored", ZIP_STORE_LEVEL, options.randomSize, [&storedRandom](uint8_t* data, size_t length) {
+        storedRandom.Fill(data, length);
+      });
+    });
+  }
+  return path;
+}
+
+/************************************************************************/
+/* Measurements                                                         */
+/************************************************************************/
+
+// the fastest of several runs of measure, in seconds
+static double fastestRun(int repetitions, const std::function<void()>& measure) {
+  double fastest = 0;
+  for (int i = 0; i < repetitions; i++) {
+    double start = seconds();
+    measure();
+    double elapsed = seconds() - start;
+    if (i == 0 || elapsed < fastest) {
+      fastest = elapsed;
+    }
+  }
+  return std::max(fastest, 1e-9);
+}
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    throw std::runtime_error("Could not open " + path);
+  }
+  std::shared_ptr<FILE> in(file, fclose);
+  std::vector<uint8_t> data;
+  uint8_t buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), in.get())) > 0) {
+    data.insert(data.end(), buffer, buffer + read);
+  }
+  return data;
+}
+
+// central directory of an archive held in memory, the same way ZipArchive finds it
+static void locateCentralDirectory(const std::vector<uint8_t>& archive, CentralDirectoryLocation* location) {
+  size_t tailLength = sizeof(EndOfCentralDirectoryRecord);
+  if (archive.size() >= tailLength + sizeof(Zip64EndOfCentralDirectoryLocator)) {
+    tailLength += sizeof(Zip64EndOfCentralDirectoryLocator);
+  }
+  if (archive.size() < tailLength ||
+      !readEndOfCentralDirectory(archive.data() + archive.size() - tailLength, tailLength, location)) {
+    throw std::runtime_error("Could not read ZIP file");
+  }
+  if (location->hasZip64Record &&
+      (location->zip64RecordOffset + sizeof(Zip64EndOfCentralDirectoryRecord) > archive.size() ||
+       !readZip64EndOfCentralDirectory(archive.data() + location->zip64RecordOffset,
+         sizeof(Zip64EndOfCentralDirectoryRecord), location))) {
+    throw std::runtime_error("Could not read ZIP64 end of central directory");
+  }
+  if (location->offset + location->size > archive.size()) {
+    throw std::runtime_error("Could not read ZIP file");
+  }
+}
+
+static void benchmarkArchive(const std::string& name, const std::string& path,
+                             const Options& options, std::vector<Result>* results) {
+  fprintf(stderr, "%s\n", name.c_str());
+  auto report = [&name, results](const char* metric, const char* unit, double value) {
+    Result result = { name, metric, unit, value };
+    results->push_back(result);
+    fprintf(stderr, "  %-26s %14.2f %s\n", metric, value, unit);
+  };
+
+  // opening maps the file and parses the central directory, ZipArchive reads from a stream instead
+  double openTime = fastestRun(options.repetitions, [&path]() {
+    MappedArchive archive(path.c_str());
+  });
+  report("mapped_open_latency", "ms", openTime * 1000);
+
+  // parsing alone, from a directory that is already in memory
+  {
+    std::vector<uint8_t> data = readFile(path);
+    CentralDirectoryLocation location;
+    locateCentralDirectory(data, &location);
+    uint64_t parsed = 0;
+    double parseTime = fastestRun(options.repetitions, [&data, &location, &parsed]() {
+      const uint8_t* record = data.data() + location.offset;
+      const uint8_t* recordsEnd = record + location.size;
+      parsed = 0;
+      EntryInfo entry;
+      while (parsed < location.entryCount && readCentralDirectoryEntry(&record, recordsEnd, &entry)) {
+        parsed++;
+      }
+    });
+    if (parsed != location.entryCount) {
+      throw std::runtime_error("Invalid ZIP file entry header in " + path);
+    }
+    report("directory_parse_rate", "entries/s", parsed / parseTime);
+
+    // parsing into the entry table and hashing the names, as ZipArchive does on open
+    double tableTime = fastestRun(options.repetitions, [&data, &location]() {
+      const uint8_t* record = data.data() + location.offset;
+      const uint8_t* recordsEnd = record + location.size;
+      EntryTable table;
+      table.Reserve(static_cast<size_t>(location.entryCount));
+      EntryInfo entry;
+      while (table.Count() < location.entryCount && readCentralDirectoryEntry(&record, recordsEnd, &entry)) {
+        table.Add(entry, 0);
+      }
+      table.BuildLookup();
+    });
+    report("entry_table_rate", "entries/s", parsed / tableTime);
+  }
+
+  MappedArchive archive(path.c_str());
+  uint64_t deflatedBytes = 0, storedBytes = 0, totalBytes = 0;
+  size_t largestBuffered = 0;
+  for (size_t i = 0; i < archive.EntryCount(); i++) {
+    const EntryInfo& entry = archive.Entry(i);
+    totalBytes += entry.uncompressedSize;
+    if (entry.record.compressionMethod == 8) {
+      deflatedBytes += entry.uncompressedSize;
+    } else {
+      storedBytes += entry.uncompressedSize;
+    }
+    if (entry.uncompressedSize <= BENCH_MAX_BUFFERED_ENTRY) {
+      largestBuffered = std::max(largestBuffered, static_cast<size_t>(entry.uncompressedSize));
+    }
+  }
+  std::vector<uint8_t> output(largestBuffered);
+  auto readEntries = [&archive, &output](uint16_t compressionMethod) {
+    for (size_t i = 0; i < archive.EntryCount(); i++) {
+      const EntryInfo& entry = archive.Entry(i);
+      if ((entry.record.compressionMethod == 8) != (compressionMethod == 8)) {
+        continue;
+      }
+      if (entry.uncompressedSize <= BENCH_MAX_BUFFERED_ENTRY) {
+        archive.ReadEntry(entry, output.data(), static_cast<size_t>(entry.uncompressedSize));
+      } else {
+        archive.ReadEntry(entry, [](const uint8_t*, size_t) {});
+      }
+    }
+  };
+
+  // both check the CRC-32 like every read through the component does
+  if (deflatedBytes > 0) {
+    double inflateTime = fastestRun(options.repetitions, [&readEntries]() {
+      readEntries(8);
+    });
+    report("inflate_throughput", "MB/s", deflatedBytes / inflateTime / 1e6);
+  }
+  if (storedBytes > 0) {
+    double copyTime = fastestRun(options.repetitions, [&readEntries]() {
+      readEntries(0);
+    });
+    report("stored_copy_throughput", "MB/s", storedBytes / copyTime / 1e6);
+  }
+
+  // everything to files on disk, removed again after every run
+  std::string destination = options.corpusDirectory + "/extracted";
+  double extractTime = fastestRun(options.repetitions, [&archive, &destination]() {
+    makeDirectory(destination);
+    std::vector<std::string> directories, files;
+    for (size_t i = 0; i < archive.EntryCount(); i++) {
+      const EntryInfo& entry = archive.Entry(i);
+      std::string filename(entry.filename, entry.filenameLength);
+      makeParentDirectories(destination, filename, &directories);
+      if (filename.empty() || filename[filename.length() - 1] == '/') {
+        continue;
+      }
+      std::string filePath = destination + "/" + filename;
+      FILE* file = fopen(filePath.c_str(), "wb");
+      if (file == nullptr) {
+        throw std::runtime_error("Could not write to file " + filePath);
+      }
+      std::shared_ptr<FILE> out(file, fclose);
+      files.push_back(filePath);
+      archive.ReadEntry(entry, [&out, &filePath](const uint8_t* data, size_t length) {
+        if (fwrite(data, 1, length, out.get()) != length) {
+          throw std::runtime_error("Could not write data for file " + filePath);
+        }
+      });
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+      remove(files[i].c_str());
+    }
+    for (size_t i = directories.size(); i > 0; i--) {
+      rmdir(directories[i - 1].c_str());
+    }
+    rmdir(destination.c_str());
+  });
+  report("mapped_extract_throughput", "MB/s", totalBytes / extractTime / 1e6);
+  report("mapped_extract_rate", "entries/s", archive.EntryCount() / extractTime);
+}
+
+/************************************************************************/
+/* Output                                                               */
+/************************************************************************/
+static std::string jsonString(const std::string& value) {
+  std::string escaped = "\"";
+  for (size_t i = 0; i < value.length(); i++) {
+    char c = value[i];
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+static void writeResults(const std::vector<Result>& results, const Options& options) {
+  FILE* out = stdout;
+  std::shared_ptr<FILE> file;
+  if (!options.outputPath.empty()) {
+    out = fopen(options.outputPath.c_str(), "w");
+    if (out == nullptr) {
+      throw std::runtime_error("Could not write to file " + options.outputPath);
+    }
+    file.reset(out, fclose);
+  }
+  fprintf(out, "{\n  \"benchmark\": \"zipbench\",\n  \"repetitions\": %d,\n  \"results\": [\n",
+    options.repetitions);
+  for (size_t i = 0; i < results.size(); i++) {
+    fprintf(out, "    {\"archive\": %s, \"metric\": %s, \"unit\": %s, \"value\": %.3f}%s\n",
+      jsonString(results[i].archive).c_str(),
+      jsonString(results[i].metric).c_str(),
+      jsonString(results[i].unit).c_str(),
+      results[i].value,
+      i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+static uint64_t parseNumber(const char* value) {
+  char* end;
+  unsigned long long number = strtoull(value, &end, 10);
+  if (*value == '\0' || *end != '\0') {
+    throw std::invalid_argument(std::string("Not a number: ") + value);
+  }
+  return number;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  options.corpusDirectory = "zipbench-corpus";
+  options.resourceDirectory = "../tests/resource";
+  options.repetitions = 5;
+  options.tinyEntryCount = 100000;
+  options.largeEntrySize = 3ULL * 1024 * 1024 * 1024;
+  options.randomSize = 256 * 1024 * 1024;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string argument = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (argument == "--smoke") {
+        options.repetitions = 1;
+        options.tinyEntryCount = 2000;
+        options.largeEntrySize = 16 * 1024 * 1024;
+        options.randomSize = 4 * 1024 * 1024;
+      } else if (argument == "--corpus" && hasValue) {
+        options.corpusDirectory = argv[++i];
+      } else if (argument == "--resources" && hasValue) {
+        options.resourceDirectory = argv[++i];
+      } else if (argument == "--output" && hasValue) {
+        options.outputPath = argv[++i];
+      } else if (argument == "--repetitions" && hasValue) {
+        options.repetitions = static_cast<int>(std::max(parseNumber(argv[++i]), (uint64_t)1));
+      } else if (argument == "--tiny-entries" && hasValue) {
+        options.tinyEntryCount = static_cast<size_t>(parseNumber(argv[++i]));
+      } else if (argument == "--large-size" && hasValue) {
+        options.largeEntrySize = parseNumber(argv[++i]);
+      } else if (argument == "--random-size" && hasValue) {
+        options.randomSize = parseNumber(argv[++i]);
+      } else {
+        fprintf(stderr, "Unknown or incomplete argument: %s\n", argv[i]);
+        return 2;
+      }
+    }
+
+    makeDirectory(options.corpusDirectory);
+    std::vector<std::pair<std::string, std::string>> corpus;
+    const char* resources[] = { "test1.docx", "test1.odt" };
+    for (size_t i = 0; i < sizeof(resources) / sizeof(resources[0]); i++) {
+      corpus.push_back(std::make_pair(resources[i], options.resourceDirectory + "/" + resources[i]));
+    }
+    corpus.push_back(std::make_pair("tiny_entries", tinyEntriesArchive(options)));
+    corpus.push_back(std::make_pair("large_entry", largeEntryArchive(options)));
+    corpus.push_back(std::make_pair("random_data", randomDataArchive(options)));
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < corpus.size(); i++) {
+      benchmarkArchive(corpus[i].first, corpus[i].second, options, &results);
+    }
+    writeResults(results, options);
+  } catch (const std::exception& error) {
+    fprintf(stderr, "zipbench: %s\n", error.what());
+    return 1;
+  }
+  return 0;
+}
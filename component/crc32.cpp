@@ -0,0 +1,219 @@
+#include "crc32.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+  #define CRC32_PCLMUL_KERNEL 1
+  #include <emmintrin.h>
+  #include <smmintrin.h>
+  #include <wmmintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #define CRC32_TARGET_PCLMUL
+    #define CRC32_ALIGN16 __declspec(align(16))
+  #else
+    #include <cpuid.h>
+    #define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+    #define CRC32_ALIGN16 __attribute__((aligned(16)))
+  #endif
+#endif
+
+using namespace runtime::doo::zip::core;
+
+// the PCLMULQDQ kernel folds 64 byte blocks, below that the tables are faster
+#define CRC32_PCLMUL_MINIMUM_LENGTH 64
+
+/************************************************************************/
+/* Lookup tables for slicing-by-8, powers of x for combining checksums  */
+/* and the CPU feature check, set up once when the module is loaded.    */
+/************************************************************************/
+// product of two polynomials modulo the CRC-32 polynomial, bit reflected like the CRC
+static uint32_t multiplyModulo(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t bit = 1U << 31; bit != 0; bit >>= 1) {
+    if (a & bit) {
+      product ^= b;
+    }
+    b = (b >> 1) ^ (0xEDB88320 & (0 - (b & 1)));
+  }
+  return product;
+}
+
+static struct Crc32Kernels {
+  uint32_t table[8][256];
+  // x^(2^n) modulo the polynomial, x^1 being 1 << 30 in reflected order;
+  // the sequence repeats after 32 steps, as the order of x divides 2^32 - 1
+  uint32_t powersOfX[32];
+  bool hasPclmul;
+
+  Crc32Kernels() : hasPclmul(false) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+      }
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int slice = 1; slice < 8; slice++) {
+        uint32_t previous = table[slice - 1][i];
+        table[slice][i] = (previous >> 8) ^ table[0][previous & 0xff];
+      }
+    }
+    powersOfX[0] = 1U << 30;
+    for (int n = 1; n < 32; n++) {
+      powersOfX[n] = multiplyModulo(powersOfX[n - 1], powersOfX[n - 1]);
+    }
+
+#if CRC32_PCLMUL_KERNEL
+    // PCLMULQDQ is ECX bit 1, SSE4.1 (for pextrd) is ECX bit 19 of leaf 1
+  #ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    unsigned int ecx = static_cast<unsigned int>(info[2]);
+  #else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  #endif
+    hasPclmul = (ecx & (1 << 1)) && (ecx & (1 << 19));
+#endif
+  }
+} kernels;
+
+static inline uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// crc is the running (inverted) register, not the finished checksum
+static uint32_t crc32Slice8(uint32_t crc, const uint8_t* data, size_t length) {
+  const uint32_t (*t)[256] = kernels.table;
+  while (length >= 8) {
+    uint32_t low = readLE32(data) ^ crc;
+    uint32_t high = readLE32(data + 4);
+    crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+          t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    data += 8;
+    length -= 8;
+  }
+  while (length--) {
+    crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if CRC32_PCLMUL_KERNEL
+/************************************************************************/
+/* Carry-less multiplication folding as described in Intel's "Fast CRC  */
+/* Computation for Generic Polynomials Using PCLMULQDQ Instruction".    */
+/* Four 128 bit lanes are folded in parallel over 64 byte blocks, then  */
+/* reduced to 128 bits, then to 32 bits with a Barrett reduction.       */
+/* length must be a multiple of 16 and at least 64.                     */
+/************************************************************************/
+CRC32_TARGET_PCLMUL
+static uint32_t crc32Pclmul(uint32_t crc, const uint8_t* data, size_t length) {
+  static const uint64_t CRC32_ALIGN16 k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+  static const uint64_t CRC32_ALIGN16 k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+  static const uint64_t CRC32_ALIGN16 k5k0[] = { 0x0163cd6124, 0x0000000000 };
+  static const uint64_t CRC32_ALIGN16 poly[] = { 0x01db710641, 0x01f7011641 };
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+  x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  x0 = _mm_load_si128((const __m128i*)k1k2);
+  data += 64;
+  length -= 64;
+
+  while (length >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    y5 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    y6 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    y7 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    y8 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+    data += 64;
+    length -= 64;
+  }
+
+  // fold the four lanes into one
+  x0 = _mm_load_si128((const __m128i*)k3k4);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  while (length >= 16) {
+    x2 = _mm_loadu_si128((const __m128i*)data);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    data += 16;
+    length -= 16;
+  }
+
+  // 128 to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+  x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  x0 = _mm_load_si128((const __m128i*)poly);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+uint32_t runtime::doo::zip::core::updateCrc32(uint32_t crc, const void* data, size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+#if CRC32_PCLMUL_KERNEL
+  if (kernels.hasPclmul && length >= CRC32_PCLMUL_MINIMUM_LENGTH) {
+    size_t foldedLength = length & ~(size_t)15;
+    crc = crc32Pclmul(crc, bytes, foldedLength);
+    bytes += foldedLength;
+    length -= foldedLength;
+  }
+#endif
+  return ~crc32Slice8(crc, bytes, length);
+}
+
+/************************************************************************/
+/* Appending length2 bytes to a sequence multiplies its CRC register by */
+/* x^(8 * length2) modulo the polynomial. That power is assembled from  */
+/* the precomputed x^(2^n), one multiplication per set bit of length2.  */
+/************************************************************************/
+uint32_t runtime::doo::zip::core::combineCrc32(uint32_t crc1, uint32_t crc2, uint64_t length2) {
+  uint32_t power = 1U << 31;
+  for (int n = 3; length2 != 0; n++, length2 >>= 1) {
+    if (length2 & 1) {
+      power = multiplyModulo(kernels.powersOfX[n & 31], power);
+    }
+  }
+  return multiplyModulo(power, crc1) ^ crc2;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // Continue the CRC-32 (as used by ZIP, polynomial 0xEDB88320) of a
+        // byte sequence. Start with crc = 0 for a new checksum.
+        // Uses a PCLMULQDQ folding kernel when the CPU supports it and
+        // slicing-by-8 otherwise.
+        uint32_t updateCrc32(uint32_t crc, const void* data, size_t length);
+
+        // The CRC-32 of two sequences joined together, given the CRC-32 of
+        // each and the length of the second one.
+        uint32_t combineCrc32(uint32_t crc1, uint32_t crc2, uint64_t length2);
+      }
+    }
+  }
+}
@@ -0,0 +1,726 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "crc32.h"
+#include "deflate.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+  #include <intrin.h>
+  #define DEFLATE_WORD_COMPARE 1
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define DEFLATE_WORD_COMPARE 1
+#endif
+
+using namespace runtime::doo::zip::core;
+
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+// enough lookahead for a maximum length match plus the next string to hash
+#define DEFLATE_MIN_LOOKAHEAD (DEFLATE_MAX_MATCH + DEFLATE_MIN_MATCH + 1)
+#define DEFLATE_MAX_DISTANCE (DEFLATE_WINDOW_SIZE - DEFLATE_MIN_LOOKAHEAD)
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+// matches of minimum length that are further away than this aren't worth it
+#define DEFLATE_TOO_FAR 4096
+// symbols per block, a block is emitted when they run out
+#define DEFLATE_SYMBOL_BUFFER_SIZE 16384
+// compressed output is handed on once this much has accumulated
+#define DEFLATE_PENDING_FLUSH_SIZE (64 * 1024)
+
+#define DEFLATE_LITERAL_CODES 286
+#define DEFLATE_DISTANCE_CODES 30
+#define DEFLATE_CODE_LENGTH_CODES 19
+#define DEFLATE_MAX_CODE_LENGTH 15
+#define DEFLATE_MAX_CODE_LENGTH_CODE_LENGTH 7
+
+/************************************************************************/
+/* Parameters of the compression levels, the same trade-offs zlib       */
+/* makes: levels 1-3 match greedily, 4-9 evaluate matches lazily and    */
+/* search longer hash chains.                                           */
+/************************************************************************/
+static const struct LevelConfig {
+  uint16_t goodLength;
+  uint16_t maxLazy;
+  uint16_t niceLength;
+  uint16_t maxChain;
+  bool lazy;
+} levelConfigs[] = {
+  { 0, 0, 0, 0, false },
+  { 4, 4, 8, 4, false },
+  { 4, 5, 16, 8, false },
+  { 4, 6, 32, 32, false },
+  { 4, 4, 16, 16, true },
+  { 8, 16, 32, 32, true },
+  { 8, 16, 128, 128, true },
+  { 8, 32, 128, 256, true },
+  { 32, 128, 258, 1024, true },
+  { 32, 258, 258, 4096, true }
+};
+
+static const uint8_t lengthExtraBits[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const uint8_t distanceExtraBits[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+static const uint8_t codeLengthOrder[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+
+static uint16_t reverseBits(uint32_t code, unsigned int length) {
+  uint32_t reversed = 0;
+  for (unsigned int i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return static_cast<uint16_t>(reversed);
+}
+
+// assign canonical codes to the given code lengths, bit reversed for LSB first output
+static void assignCodes(const uint8_t* lengths, size_t count, uint16_t* codes) {
+  uint32_t lengthCounts[DEFLATE_MAX_CODE_LENGTH + 1] = { 0 };
+  for (size_t i = 0; i < count; i++) {
+    lengthCounts[lengths[i]]++;
+  }
+  lengthCounts[0] = 0;
+  uint32_t nextCode[DEFLATE_MAX_CODE_LENGTH + 1] = { 0 };
+  uint32_t code = 0;
+  for (unsigned int bits = 1; bits <= DEFLATE_MAX_CODE_LENGTH; bits++) {
+    code = (code + lengthCounts[bits - 1]) << 1;
+    nextCode[bits] = code;
+  }
+  for (size_t i = 0; i < count; i++) {
+    codes[i] = lengths[i] ? reverseBits(nextCode[lengths[i]]++, lengths[i]) : 0;
+  }
+}
+
+/************************************************************************/
+/* Lookup tables from match lengths and distances to their codes, plus  */
+/* the fixed Huffman code, set up once when the module is loaded.       */
+/************************************************************************/
+static struct DeflateTables {
+  // match length - 3 -> length code
+  uint8_t lengthCode[256];
+  // distance - 1 -> distance code, below 256 directly, above at 256 + ((distance - 1) >> 7)
+  uint8_t distanceCode[512];
+  uint16_t lengthBase[29];
+  uint16_t distanceBase[30];
+  // the fixed code covers 288 symbols, the last two are never used
+  uint8_t fixedLiteralLengths[288];
+  uint16_t fixedLiteralCodes[288];
+  uint8_t fixedDistanceLengths[DEFLATE_DISTANCE_CODES];
+  uint16_t fixedDistanceCodes[DEFLATE_DISTANCE_CODES];
+
+  DeflateTables() {
+    unsigned int length = 0;
+    for (unsigned int code = 0; code < 28; code++) {
+      lengthBase[code] = static_cast<uint16_t>(length + DEFLATE_MIN_MATCH);
+      for (unsigned int n = 0; n < (1U << lengthExtraBits[code]); n++) {
+        lengthCode[length++] = static_cast<uint8_t>(code);
+      }
+    }
+    // 258 has a code of its own
+    lengthCode[255] = 28;
+    lengthBase[28] = DEFLATE_MAX_MATCH;
+
+    unsigned int distance = 0;
+    for (unsigned int code = 0; code < 16; code++) {
+      distanceBase[code] = static_cast<uint16_t>(distance + 1);
+      for (unsigned int n = 0; n < (1U << distanceExtraBits[code]); n++) {
+        distanceCode[distance++] = static_cast<uint8_t>(code);
+      }
+    }
+    distance >>= 7;
+    for (unsigned int code = 16; code < DEFLATE_DISTANCE_CODES; code++) {
+      distanceBase[code] = static_cast<uint16_t>((distance << 7) + 1);
+      for (unsigned int n = 0; n < (1U << (distanceExtraBits[code] - 7)); n++) {
+        distanceCode[256 + distance++] = static_cast<uint8_t>(code);
+      }
+    }
+
+    for (unsigned int i = 0; i < 288; i++) {
+      fixedLiteralLengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    assignCodes(fixedLiteralLengths, 288, fixedLiteralCodes);
+    memset(fixedDistanceLengths, 5, sizeof(fixedDistanceLengths));
+    assignCodes(fixedDistanceLengths, DEFLATE_DISTANCE_CODES, fixedDistanceCodes);
+  }
+
+  unsigned int DistanceCode(size_t distance) const {
+    size_t d = distance - 1;
+    return d < 256 ? distanceCode[d] : distanceCode[256 + (d >> 7)];
+  }
+} tables;
+
+/************************************************************************/
+/* Compute Huffman code lengths of at most maxLength bits for the given */
+/* symbol frequencies. The tree is built with the two-queue method, too */
+/* long codes are then shortened by moving leaves up the tree until the */
+/* Kraft sum fits again, longest codes going to the rarest symbols. At  */
+/* least two symbols get a code, which keeps every decoder happy.       */
+/************************************************************************/
+static void buildCodeLengths(const uint32_t* frequencies, size_t count, unsigned int maxLength, uint8_t* lengths) {
+  uint32_t weights[2 * DEFLATE_LITERAL_CODES];
+  uint16_t symbols[DEFLATE_LITERAL_CODES];
+  uint16_t parents[2 * DEFLATE_LITERAL_CODES];
+  uint8_t depths[2 * DEFLATE_LITERAL_CODES];
+
+  memset(lengths, 0, count);
+  size_t leafCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (frequencies[i] > 0) {
+      symbols[leafCount++] = static_cast<uint16_t>(i);
+    }
+  }
+  for (size_t i = 0; leafCount < 2 && i < count; i++) {
+    if (frequencies[i] == 0) {
+      symbols[leafCount++] = static_cast<uint16_t>(i);
+    }
+  }
+  std::sort(symbols, symbols + leafCount, [frequencies](uint16_t a, uint16_t b) {
+    return frequencies[a] != frequencies[b] ? frequencies[a] < frequencies[b] : a < b;
+  });
+  for (size_t i = 0; i < leafCount; i++) {
+    weights[i] = std::max(frequencies[symbols[i]], 1U);
+  }
+
+  // leaves and internal nodes are both created in ascending order of weight
+  size_t nextLeaf = 0, nextInternal = leafCount, nodeCount = leafCount;
+  for (size_t merged = 0; merged + 1 < leafCount; merged++) {
+    size_t children[2];
+    for (int c = 0; c < 2; c++) {
+      if (nextLeaf < leafCount && (nextInternal >= nodeCount || weights[nextLeaf] <= weights[nextInternal])) {
+        children[c] = nextLeaf++;
+      } else {
+        children[c] = nextInternal++;
+      }
+    }
+    weights[nodeCount] = weights[children[0]] + weights[children[1]];
+    parents[children[0]] = parents[children[1]] = static_cast<uint16_t>(nodeCount);
+    nodeCount++;
+  }
+  depths[nodeCount - 1] = 0;
+  for (size_t node = nodeCount - 1; node-- > 0; ) {
+    depths[node] = static_cast<uint8_t>(std::min(depths[parents[node]] + 1, 255));
+  }
+
+  uint32_t lengthCounts[256] = { 0 };
+  for (size_t i = 0; i < leafCount; i++) {
+    lengthCounts[std::min<unsigned int>(depths[i], maxLength)]++;
+  }
+  uint32_t total = 0;
+  for (unsigned int bits = 1; bits <= maxLength; bits++) {
+    total += lengthCounts[bits] << (maxLength - bits);
+  }
+  while (total > (1U << maxLength)) {
+    lengthCounts[maxLength]--;
+    for (unsigned int bits = maxLength - 1; bits > 0; bits--) {
+      if (lengthCounts[bits] > 0) {
+        lengthCounts[bits]--;
+        lengthCounts[bits + 1] += 2;
+        break;
+      }
+    }
+    total--;
+  }
+
+  size_t leaf = 0;
+  for (unsigned int bits = maxLength; bits > 0; bits--) {
+    for (uint32_t n = lengthCounts[bits]; n > 0; n--) {
+      lengths[symbols[leaf++]] = static_cast<uint8_t>(bits);
+    }
+  }
+}
+
+struct Deflater::Huffman {
+  uint8_t lengths[DEFLATE_LITERAL_CODES];
+  uint16_t codes[DEFLATE_LITERAL_CODES];
+};
+
+Deflater::Deflater(int level) :
+  window(new uint8_t[2 * DEFLATE_WINDOW_SIZE]),
+  head(new uint16_t[DEFLATE_HASH_SIZE]),
+  previous(new uint16_t[DEFLATE_WINDOW_SIZE]),
+  windowEnd(0),
+  position(0),
+  blockStart(0),
+  matchAvailable(false),
+  matchLength(DEFLATE_MIN_MATCH - 1),
+  matchStart(0),
+  symbolLiterals(new uint8_t[DEFLATE_SYMBOL_BUFFER_SIZE]),
+  symbolDistances(new uint16_t[DEFLATE_SYMBOL_BUFFER_SIZE]),
+  symbolCount(0),
+  symbolCapacity(DEFLATE_SYMBOL_BUFFER_SIZE),
+  bitBuffer(0),
+  bitCount(0),
+  finished(false),
+  crc(0),
+  totalIn(0),
+  totalOut(0) {
+  level = std::min(std::max(level, DEFLATE_MIN_LEVEL), DEFLATE_MAX_LEVEL);
+  goodLength = levelConfigs[level].goodLength;
+  maxLazy = levelConfigs[level].maxLazy;
+  niceLength = levelConfigs[level].niceLength;
+  maxChain = levelConfigs[level].maxChain;
+  lazyMatching = levelConfigs[level].lazy;
+
+  memset(head.get(), 0, DEFLATE_HASH_SIZE * sizeof(uint16_t));
+  memset(previous.get(), 0, DEFLATE_WINDOW_SIZE * sizeof(uint16_t));
+  memset(literalFrequencies, 0, sizeof(literalFrequencies));
+  memset(distanceFrequencies, 0, sizeof(distanceFrequencies));
+  pending.reserve(DEFLATE_PENDING_FLUSH_SIZE + DEFLATE_SYMBOL_BUFFER_SIZE * 4);
+}
+
+Deflater::~Deflater() {
+}
+
+void Deflater::Deflate(const uint8_t* input, size_t length, DeflateFlush flush, const OutputSink& consumeOutput) {
+  if (finished) {
+    throw std::logic_error("The DEFLATE stream is already finished");
+  }
+  crc = updateCrc32(crc, input, length);
+  totalIn += length;
+
+  for (;;) {
+    if (length > 0 && windowEnd == 2 * DEFLATE_WINDOW_SIZE) {
+      SlideWindow();
+    }
+    size_t copied = std::min(length, 2 * DEFLATE_WINDOW_SIZE - windowEnd);
+    if (copied > 0) {
+      memcpy(window.get() + windowEnd, input, copied);
+      windowEnd += copied;
+      input += copied;
+      length -= copied;
+    }
+
+    bool flushing = length == 0 && flush != DEFLATE_NO_FLUSH;
+    if (lazyMatching) {
+      CompressLazy(flushing);
+    } else {
+      CompressGreedy(flushing);
+    }
+    if (length == 0) {
+      break;
+    }
+    if (pending.size() >= DEFLATE_PENDING_FLUSH_SIZE) {
+      FlushPending(consumeOutput);
+    }
+  }
+
+  if (flush == DEFLATE_SYNC_FLUSH) {
+    FlushBlock(false);
+    WriteStoredBlocks(nullptr, 0, false);
+  } else if (flush == DEFLATE_FINISH) {
+    FlushBlock(true);
+    AlignToByte();
+    finished = true;
+  }
+  FlushPending(consumeOutput);
+}
+
+void Deflater::SetDictionary(const uint8_t* dictionary, size_t length) {
+  if (totalIn > 0 || windowEnd > 0) {
+    throw std::logic_error("The dictionary has to be set before any input");
+  }
+  if (length > DEFLATE_MAX_DISTANCE) {
+    dictionary += length - DEFLATE_MAX_DISTANCE;
+    length = DEFLATE_MAX_DISTANCE;
+  }
+  memcpy(window.get(), dictionary, length);
+  windowEnd = length;
+  for (size_t i = 0; i + DEFLATE_MIN_MATCH <= length; i++) {
+    InsertString(i);
+  }
+  position = length;
+  blockStart = length;
+}
+
+/************************************************************************/
+/* Move the upper half of the window down once the lower half is out of */
+/* reach, and rebase the hash chains. The current block is emitted      */
+/* first if it still needs bytes from the lower half.                   */
+/************************************************************************/
+void Deflater::SlideWindow() {
+  if (blockStart < DEFLATE_WINDOW_SIZE) {
+    FlushBlock(false);
+  }
+  memcpy(window.get(), window.get() + DEFLATE_WINDOW_SIZE, DEFLATE_WINDOW_SIZE);
+  windowEnd -= DEFLATE_WINDOW_SIZE;
+  position -= DEFLATE_WINDOW_SIZE;
+  blockStart -= DEFLATE_WINDOW_SIZE;
+  matchStart = matchStart >= DEFLATE_WINDOW_SIZE ? matchStart - DEFLATE_WINDOW_SIZE : 0;
+  for (size_t i = 0; i < DEFLATE_HASH_SIZE; i++) {
+    head[i] = static_cast<uint16_t>(head[i] >= DEFLATE_WINDOW_SIZE ? head[i] - DEFLATE_WINDOW_SIZE : 0);
+  }
+  for (size_t i = 0; i < DEFLATE_WINDOW_SIZE; i++) {
+    previous[i] = static_cast<uint16_t>(previous[i] >= DEFLATE_WINDOW_SIZE ? previous[i] - DEFLATE_WINDOW_SIZE : 0);
+  }
+}
+
+// Hash the three bytes at the given position into the chains and return the
+// previous position with the same hash, 0 if there is none.
+uint32_t Deflater::InsertString(size_t at) {
+  if (at + DEFLATE_MIN_MATCH > windowEnd) {
+    return 0;
+  }
+  const uint8_t* bytes = window.get() + at;
+  uint32_t key = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16);
+  uint32_t hash = (key * 2654435761U) >> (32 - DEFLATE_HASH_BITS);
+  uint32_t candidate = head[hash];
+  previous[at & DEFLATE_WINDOW_MASK] = static_cast<uint16_t>(candidate);
+  head[hash] = static_cast<uint16_t>(at);
+  return candidate;
+}
+
+static size_t compareBytes(const uint8_t* scan, const uint8_t* match, size_t maxLength) {
+  size_t length = 0;
+#if DEFLATE_WORD_COMPARE
+  while (length + 8 <= maxLength) {
+    uint64_t a, b;
+    memcpy(&a, scan + length, sizeof(a));
+    memcpy(&b, match + length, sizeof(b));
+    uint64_t difference = a ^ b;
+    if (difference != 0) {
+  #ifdef _MSC_VER
+      unsigned long bit;
+      _BitScanForward64(&bit, difference);
+      return length + (bit >> 3);
+  #else
+      return length + (__builtin_ctzll(difference) >> 3);
+  #endif
+    }
+    length += 8;
+  }
+#endif
+  while (length < maxLength && scan[length] == match[length]) {
+    length++;
+  }
+  return length;
+}
+
+/************************************************************************/
+/* Walk the hash chain from candidate and return the length of the      */
+/* longest match at the current position that beats bestLength, or      */
+/* bestLength if there is none. matchStart is set to where it starts.   */
+/************************************************************************/
+size_t Deflater::LongestMatch(uint32_t candidate, size_t bestLength) {
+  size_t maxLength = std::min((size_t)DEFLATE_MAX_MATCH, Lookahead());
+  if (bestLength >= maxLength) {
+    return bestLength;
+  }
+  size_t chainLength = bestLength >= goodLength ? maxChain >> 2 : maxChain;
+  size_t nice = std::min(niceLength, maxLength);
+  size_t limit = position > DEFLATE_MAX_DISTANCE ? position - DEFLATE_MAX_DISTANCE : 0;
+  const uint8_t* scan = window.get() + position;
+  do {
+    const uint8_t* match = window.get() + candidate;
+    if (match[bestLength] != scan[bestLength] || match[0] != scan[0] || match[1] != scan[1]) {
+      continue;
+    }
+    size_t length = compareBytes(scan, match, maxLength);
+    if (length > bestLength) {
+      matchStart = candidate;
+      bestLength = length;
+      if (length >= nice) {
+        break;
+      }
+    }
+  } while ((candidate = previous[candidate & DEFLATE_WINDOW_MASK]) > limit && --chainLength != 0);
+  return bestLength;
+}
+
+// Levels 1-3: take the longest match at each position right away.
+void Deflater::CompressGreedy(bool flushing) {
+  while (Lookahead() >= DEFLATE_MIN_LOOKAHEAD || (flushing && Lookahead() > 0)) {
+    uint32_t candidate = InsertString(position);
+    size_t length = 0;
+    if (candidate != 0 && position - candidate <= DEFLATE_MAX_DISTANCE) {
+      length = LongestMatch(candidate, DEFLATE_MIN_MATCH - 1);
+    }
+    if (length >= DEFLATE_MIN_MATCH) {
+      TallyMatch(position - matchStart, length);
+      // short matches are hashed completely, long ones skipped for speed
+      if (length <= maxLazy) {
+        for (size_t i = 1; i < length; i++) {
+          InsertString(position + i);
+        }
+      }
+      position += length;
+    } else {
+      TallyLiteral(window[position]);
+      position++;
+    }
+    if (SymbolBufferFull()) {
+      FlushBlock(false);
+    }
+  }
+}
+
+// Levels 4-9: a match is only taken if the next position doesn't start a longer one.
+void Deflater::CompressLazy(bool flushing) {
+  while (Lookahead() >= DEFLATE_MIN_LOOKAHEAD || (flushing && Lookahead() > 0)) {
+    uint32_t candidate = InsertString(position);
+    size_t previousLength = matchLength;
+    size_t previousMatch = matchStart;
+    matchLength = DEFLATE_MIN_MATCH - 1;
+    if (candidate != 0 && previousLength < maxLazy && position - candidate <= DEFLATE_MAX_DISTANCE) {
+      matchLength = LongestMatch(candidate, previousLength);
+      if (matchLength == DEFLATE_MIN_MATCH && position - matchStart > DEFLATE_TOO_FAR) {
+        matchLength = DEFLATE_MIN_MATCH - 1;
+      }
+    }
+
+    if (previousLength >= DEFLATE_MIN_MATCH && matchLength <= previousLength) {
+      // the match found at the previous position wins, positions up to the
+      // current one have been hashed already
+      TallyMatch(position - 1 - previousMatch, previousLength);
+      for (size_t i = 1; i + 1 < previousLength; i++) {
+        InsertString(position + i);
+      }
+      position += previousLength - 1;
+      matchAvailable = false;
+      matchLength = DEFLATE_MIN_MATCH - 1;
+    } else if (matchAvailable) {
+      TallyLiteral(window[position - 1]);
+      position++;
+    } else {
+      matchAvailable = true;
+      position++;
+    }
+    if (SymbolBufferFull()) {
+      FlushBlock(false);
+    }
+  }
+  if (flushing && matchAvailable) {
+    TallyLiteral(window[position - 1]);
+    matchAvailable = false;
+    matchLength = DEFLATE_MIN_MATCH - 1;
+  }
+}
+
+void Deflater::TallyLiteral(uint8_t literal) {
+  symbolLiterals[symbolCount] = literal;
+  symbolDistances[symbolCount] = 0;
+  symbolCount++;
+  literalFrequencies[literal]++;
+}
+
+void Deflater::TallyMatch(size_t distance, size_t length) {
+  symbolLiterals[symbolCount] = static_cast<uint8_t>(length - DEFLATE_MIN_MATCH);
+  symbolDistances[symbolCount] = static_cast<uint16_t>(distance);
+  symbolCount++;
+  literalFrequencies[257 + tables.lengthCode[length - DEFLATE_MIN_MATCH]]++;
+  distanceFrequencies[tables.DistanceCode(distance)]++;
+}
+
+/************************************************************************/
+/* Emit the symbols collected since the last block with the cheapest of */
+/* dynamic Huffman, fixed Huffman and stored coding.                    */
+/************************************************************************/
+void Deflater::FlushBlock(bool final) {
+  // with a lazy match pending, the byte before the current position isn't tallied yet
+  size_t blockEnd = position - (matchAvailable ? 1 : 0);
+  if (symbolCount == 0 && !final) {
+    return;
+  }
+  literalFrequencies[256] = 1;
+
+  Huffman literals, distances;
+  buildCodeLengths(literalFrequencies, DEFLATE_LITERAL_CODES, DEFLATE_MAX_CODE_LENGTH, literals.lengths);
+  assignCodes(literals.lengths, DEFLATE_LITERAL_CODES, literals.codes);
+  buildCodeLengths(distanceFrequencies, DEFLATE_DISTANCE_CODES, DEFLATE_MAX_CODE_LENGTH, distances.lengths);
+  assignCodes(distances.lengths, DEFLATE_DISTANCE_CODES, distances.codes);
+
+  // run length encode the code lengths of both codes for the dynamic block header
+  size_t literalCount = DEFLATE_LITERAL_CODES;
+  while (literalCount > 257 && literals.lengths[literalCount - 1] == 0) {
+    literalCount--;
+  }
+  size_t distanceCount = DEFLATE_DISTANCE_CODES;
+  while (distanceCount > 1 && distances.lengths[distanceCount - 1] == 0) {
+    distanceCount--;
+  }
+  uint8_t allLengths[DEFLATE_LITERAL_CODES + DEFLATE_DISTANCE_CODES];
+  memcpy(allLengths, literals.lengths, literalCount);
+  memcpy(allLengths + literalCount, distances.lengths, distanceCount);
+  size_t lengthCount = literalCount + distanceCount;
+
+  uint8_t runSymbols[DEFLATE_LITERAL_CODES + DEFLATE_DISTANCE_CODES];
+  uint8_t runExtras[DEFLATE_LITERAL_CODES + DEFLATE_DISTANCE_CODES];
+  size_t runCount = 0;
+  uint32_t codeLengthFrequencies[DEFLATE_CODE_LENGTH_CODES] = { 0 };
+  for (size_t i = 0; i < lengthCount; ) {
+    uint8_t length = allLengths[i];
+    size_t run = 1;
+    while (i + run < lengthCount && allLengths[i + run] == length) {
+      run++;
+    }
+    i += run;
+    if (length == 0) {
+      while (run >= 11) {
+        size_t repeat = std::min(run, (size_t)138);
+        runSymbols[runCount] = 18;
+        runExtras[runCount++] = static_cast<uint8_t>(repeat - 11);
+        run -= repeat;
+      }
+      if (run >= 3) {
+        runSymbols[runCount] = 17;
+        runExtras[runCount++] = static_cast<uint8_t>(run - 3);
+        run = 0;
+      }
+    } else {
+      runSymbols[runCount] = length;
+      runExtras[runCount++] = 0;
+      run--;
+      while (run >= 3) {
+        size_t repeat = std::min(run, (size_t)6);
+        runSymbols[runCount] = 16;
+        runExtras[runCount++] = static_cast<uint8_t>(repeat - 3);
+        run -= repeat;
+      }
+    }
+    while (run-- > 0) {
+      runSymbols[runCount] = length;
+      runExtras[runCount++] = 0;
+    }
+  }
+  for (size_t i = 0; i < runCount; i++) {
+    codeLengthFrequencies[runSymbols[i]]++;
+  }
+  uint8_t codeLengthLengths[DEFLATE_CODE_LENGTH_CODES];
+  uint16_t codeLengthCodes[DEFLATE_CODE_LENGTH_CODES];
+  buildCodeLengths(codeLengthFrequencies, DEFLATE_CODE_LENGTH_CODES,
+    DEFLATE_MAX_CODE_LENGTH_CODE_LENGTH, codeLengthLengths);
+  assignCodes(codeLengthLengths, DEFLATE_CODE_LENGTH_CODES, codeLengthCodes);
+  size_t codeLengthCount = DEFLATE_CODE_LENGTH_CODES;
+  while (codeLengthCount > 4 && codeLengthLengths[codeLengthOrder[codeLengthCount - 1]] == 0) {
+    codeLengthCount--;
+  }
+
+  // sizes of the block in bits for each kind of coding
+  uint64_t extraBits = 0, dynamicBits = 0, fixedBits = 0;
+  for (size_t i = 0; i < DEFLATE_LITERAL_CODES; i++) {
+    dynamicBits += (uint64_t)literalFrequencies[i] * literals.lengths[i];
+    fixedBits += (uint64_t)literalFrequencies[i] * tables.fixedLiteralLengths[i];
+    if (i > 256) {
+      extraBits += (uint64_t)literalFrequencies[i] * lengthExtraBits[i - 257];
+    }
+  }
+  for (size_t i = 0; i < DEFLATE_DISTANCE_CODES; i++) {
+    dynamicBits += (uint64_t)distanceFrequencies[i] * distances.lengths[i];
+    fixedBits += (uint64_t)distanceFrequencies[i] * tables.fixedDistanceLengths[i];
+    extraBits += (uint64_t)distanceFrequencies[i] * distanceExtraBits[i];
+  }
+  dynamicBits += 3 + 5 + 5 + 4 + 3 * codeLengthCount + extraBits;
+  for (size_t i = 0; i < DEFLATE_CODE_LENGTH_CODES; i++) {
+    dynamicBits += (uint64_t)codeLengthFrequencies[i] * codeLengthLengths[i];
+  }
+  dynamicBits += 2 * codeLengthFrequencies[16] + 3 * codeLengthFrequencies[17] + 7 * codeLengthFrequencies[18];
+  fixedBits += 3 + extraBits;
+  size_t storedLength = blockEnd - blockStart;
+  size_t storedBlocks = std::max((storedLength + 65534) / 65535, (size_t)1);
+  uint64_t storedBits = 3 + ((8 - (bitCount + 3) % 8) % 8) + 32 +
+    (storedBlocks - 1) * (3 + 5 + 32) + (uint64_t)storedLength * 8;
+
+  if (storedBits <= fixedBits && storedBits <= dynamicBits) {
+    WriteStoredBlocks(window.get() + blockStart, storedLength, final);
+  } else if (fixedBits <= dynamicBits) {
+    Huffman fixedLiterals, fixedDistances;
+    memcpy(fixedLiterals.lengths, tables.fixedLiteralLengths, sizeof(fixedLiterals.lengths));
+    memcpy(fixedLiterals.codes, tables.fixedLiteralCodes, sizeof(fixedLiterals.codes));
+    memcpy(fixedDistances.lengths, tables.fixedDistanceLengths, sizeof(tables.fixedDistanceLengths));
+    memcpy(fixedDistances.codes, tables.fixedDistanceCodes, sizeof(tables.fixedDistanceCodes));
+    PutBits((final ? 1 : 0) | (1 << 1), 3);
+    WriteCompressedBlock(fixedLiterals, fixedDistances);
+  } else {
+    PutBits((final ? 1 : 0) | (2 << 1), 3);
+    PutBits(static_cast<uint32_t>(literalCount - 257), 5);
+    PutBits(static_cast<uint32_t>(distanceCount - 1), 5);
+    PutBits(static_cast<uint32_t>(codeLengthCount - 4), 4);
+    for (size_t i = 0; i < codeLengthCount; i++) {
+      PutBits(codeLengthLengths[codeLengthOrder[i]], 3);
+    }
+    for (size_t i = 0; i < runCount; i++) {
+      uint8_t symbol = runSymbols[i];
+      PutBits(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+      if (symbol >= 16) {
+        PutBits(runExtras[i], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+      }
+    }
+    WriteCompressedBlock(literals, distances);
+  }
+
+  memset(literalFrequencies, 0, sizeof(literalFrequencies));
+  memset(distanceFrequencies, 0, sizeof(distanceFrequencies));
+  symbolCount = 0;
+  blockStart = blockEnd;
+}
+
+// Store data uncompressed in blocks of at most 64 KB. Without data, this is
+// the empty block that ends a sync flush on a byte boundary.
+void Deflater::WriteStoredBlocks(const uint8_t* data, size_t length, bool final) {
+  do {
+    size_t blockLength = std::min(length, (size_t)65535);
+    bool last = blockLength == length;
+    PutBits(final && last ? 1 : 0, 3);
+    AlignToByte();
+    PutBits(static_cast<uint32_t>(blockLength), 16);
+    PutBits(static_cast<uint32_t>(~blockLength & 0xFFFF), 16);
+    if (blockLength > 0) {
+      pending.insert(pending.end(), data, data + blockLength);
+    }
+    data += blockLength;
+    length -= blockLength;
+  } while (length > 0);
+}
+
+void Deflater::WriteCompressedBlock(const Huffman& literals, const Huffman& distances) {
+  for (size_t i = 0; i < symbolCount; i++) {
+    unsigned int literal = symbolLiterals[i];
+    size_t distance = symbolDistances[i];
+    if (distance == 0) {
+      PutBits(literals.codes[literal], literals.lengths[literal]);
+      continue;
+    }
+    unsigned int lengthCode = tables.lengthCode[literal];
+    PutBits(literals.codes[257 + lengthCode], literals.lengths[257 + lengthCode]);
+    if (lengthExtraBits[lengthCode]) {
+      PutBits(literal + DEFLATE_MIN_MATCH - tables.lengthBase[lengthCode], lengthExtraBits[lengthCode]);
+    }
+    unsigned int distanceCode = tables.DistanceCode(distance);
+    PutBits(distances.codes[distanceCode], distances.lengths[distanceCode]);
+    if (distanceExtraBits[distanceCode]) {
+      PutBits(static_cast<uint32_t>(distance - tables.distanceBase[distanceCode]), distanceExtraBits[distanceCode]);
+    }
+  }
+  PutBits(literals.codes[256], literals.lengths[256]);
+}
+
+void Deflater::PutBits(uint32_t value, unsigned int count) {
+  bitBuffer |= (uint64_t)value << bitCount;
+  bitCount += count;
+  if (bitCount >= 32) {
+    uint8_t bytes[4] = {
+      static_cast<uint8_t>(bitBuffer), static_cast<uint8_t>(bitBuffer >> 8),
+      static_cast<uint8_t>(bitBuffer >> 16), static_cast<uint8_t>(bitBuffer >> 24)
+    };
+    pending.insert(pending.end(), bytes, bytes + 4);
+    bitBuffer >>= 32;
+    bitCount -= 32;
+  }
+}
+
+void Deflater::AlignToByte() {
+  while (bitCount > 0) {
+    pending.push_back(static_cast<uint8_t>(bitBuffer));
+    bitBuffer >>= 8;
+    bitCount = bitCount > 8 ? bitCount - 8 : 0;
+  }
+  bitBuffer = 0;
+}
+
+void Deflater::FlushPending(const OutputSink& consumeOutput) {
+  if (!pending.empty()) {
+    consumeOutput(pending.data(), pending.size());
+    totalOut += pending.size();
+    pending.clear();
+  }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // receives compressed (or otherwise produced) output piece by piece
+        typedef std::function<void(const uint8_t*, size_t)> OutputSink;
+
+        enum DeflateFlush {
+          // compress as much as possible, input may be held back for matching
+          DEFLATE_NO_FLUSH,
+          // compress all input and end on a byte boundary with an empty stored block
+          DEFLATE_SYNC_FLUSH,
+          // compress all input and end the stream with a final block
+          DEFLATE_FINISH
+        };
+
+        const int DEFLATE_MIN_LEVEL = 1;
+        const int DEFLATE_MAX_LEVEL = 9;
+        const int DEFLATE_DEFAULT_LEVEL = 6;
+
+        /************************************************************************/
+        /* Incremental raw DEFLATE compressor. Matches are found with hash      */
+        /* chains over a 32 KB window, greedily for the fast levels and with    */
+        /* lazy evaluation for the higher ones. Every block is emitted with     */
+        /* whichever of dynamic Huffman, fixed Huffman or stored coding is      */
+        /* smallest. The CRC-32 of the input is computed on the fly.            */
+        /************************************************************************/
+        class Deflater {
+        public:
+          // level from DEFLATE_MIN_LEVEL (fastest) to DEFLATE_MAX_LEVEL (smallest)
+          explicit Deflater(int level);
+          ~Deflater();
+
+          // Compress input, handing the output to consumeOutput. After a call
+          // with DEFLATE_FINISH the stream is complete.
+          void Deflate(
+            const uint8_t* input,
+            size_t length,
+            DeflateFlush flush,
+            const OutputSink& consumeOutput
+            );
+
+          // Prime the window with data that precedes the input, so matches can
+          // refer back into it. Only the part within reach of a match, just
+          // under the last 32 KB, is used. Has to be called before the first
+          // call to Deflate(); the dictionary isn't part of the output or the
+          // CRC-32.
+          void SetDictionary(const uint8_t* dictionary, size_t length);
+
+          uint32_t Crc32() const { return crc; }
+          uint64_t TotalIn() const { return totalIn; }
+          uint64_t TotalOut() const { return totalOut; }
+
+        private:
+          Deflater(const Deflater&);
+          Deflater& operator=(const Deflater&);
+
+          struct Huffman;
+
+          size_t Lookahead() const { return windowEnd - position; }
+          void SlideWindow();
+          uint32_t InsertString(size_t at);
+          size_t LongestMatch(uint32_t candidate, size_t bestLength);
+          void CompressGreedy(bool flushing);
+          void CompressLazy(bool flushing);
+          void TallyLiteral(uint8_t literal);
+          void TallyMatch(size_t distance, size_t length);
+          bool SymbolBufferFull() const { return symbolCount == symbolCapacity; }
+          void FlushBlock(bool final);
+          void WriteStoredBlocks(const uint8_t* data, size_t length, bool final);
+          void WriteCompressedBlock(const Huffman& literals, const Huffman& distances);
+          void PutBits(uint32_t value, unsigned int count);
+          void AlignToByte();
+          void FlushPending(const OutputSink& consumeOutput);
+
+          // matching parameters of the compression level
+          size_t goodLength;
+          size_t maxLazy;
+          size_t niceLength;
+          size_t maxChain;
+          bool lazyMatching;
+
+          std::unique_ptr<uint8_t[]> window;
+          std::unique_ptr<uint16_t[]> head;
+          std::unique_ptr<uint16_t[]> previous;
+          size_t windowEnd;
+          size_t position;
+          size_t blockStart;
+
+          // lazy matching state
+          bool matchAvailable;
+          size_t matchLength;
+          size_t matchStart;
+
+          // symbols of the current block: literal or match length - 3, and distance (0 for literals)
+          std::unique_ptr<uint8_t[]> symbolLiterals;
+          std::unique_ptr<uint16_t[]> symbolDistances;
+          size_t symbolCount;
+          size_t symbolCapacity;
+          uint32_t literalFrequencies[286];
+          uint32_t distanceFrequencies[30];
+
+          uint64_t bitBuffer;
+          unsigned int bitCount;
+          std::vector<uint8_t> pending;
+
+          bool finished;
+          uint32_t crc;
+          uint64_t totalIn;
+          uint64_t totalOut;
+        };
+      }
+    }
+  }
+}
@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "directoryindex.h"
+
+using namespace runtime::doo::zip::core;
+
+// "ZDIR" followed by the format version
+#define DIRECTORY_INDEX_SIGNATURE 0x5249445A
+#define DIRECTORY_INDEX_VERSION 1
+
+#pragma pack(1)
+struct DirectoryIndexHeader {
+  uint32_t signature;
+  uint16_t version;
+  uint64_t archiveSize;
+  uint64_t lastModified;
+  uint32_t tailCrc32;
+  uint64_t entryCount;
+};
+
+struct DirectoryIndexEntry {
+  CentralDirectoryRecord record;
+  uint64_t compressedSize;
+  uint64_t uncompressedSize;
+  uint64_t localHeaderOffset;
+  uint64_t contentStart;
+};
+#pragma pack()
+
+bool runtime::doo::zip::core::operator==(const ArchiveFingerprint& a, const ArchiveFingerprint& b) {
+  return a.archiveSize == b.archiveSize &&
+    a.lastModified == b.lastModified &&
+    a.tailCrc32 == b.tailCrc32;
+}
+
+void runtime::doo::zip::core::appendDirectoryIndexHeader(std::vector<uint8_t>* output,
+                                                         const ArchiveFingerprint& fingerprint,
+                                                         uint64_t entryCount) {
+  DirectoryIndexHeader header;
+  header.signature = DIRECTORY_INDEX_SIGNATURE;
+  header.version = DIRECTORY_INDEX_VERSION;
+  header.archiveSize = fingerprint.archiveSize;
+  header.lastModified = fingerprint.lastModified;
+  header.tailCrc32 = fingerprint.tailCrc32;
+  header.entryCount = entryCount;
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&header);
+  output->insert(output->end(), data, data + sizeof(header));
+}
+
+void runtime::doo::zip::core::appendDirectoryIndexEntry(std::vector<uint8_t>* output,
+                                                        const EntryInfo& entry,
+                                                        uint64_t contentStart) {
+  DirectoryIndexEntry indexEntry;
+  indexEntry.record = entry.record;
+  // the filename is all that is kept of the variable length fields
+  indexEntry.record.filenameLength = entry.filenameLength;
+  indexEntry.record.extraFieldLength = 0;
+  indexEntry.record.fileCommentLength = 0;
+  indexEntry.compressedSize = entry.compressedSize;
+  indexEntry.uncompressedSize = entry.uncompressedSize;
+  indexEntry.localHeaderOffset = entry.localHeaderOffset;
+  indexEntry.contentStart = contentStart;
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&indexEntry);
+  output->insert(output->end(), data, data + sizeof(indexEntry));
+  output->insert(output->end(), entry.filename, entry.filename + entry.filenameLength);
+}
+
+bool runtime::doo::zip::core::readDirectoryIndexHeader(const uint8_t** data,
+                                                       const uint8_t* end,
+                                                       ArchiveFingerprint* fingerprint,
+                                                       uint64_t* entryCount) {
+  DirectoryIndexHeader header;
+  if ((size_t)(end - *data) < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, *data, sizeof(header));
+  if (header.signature != DIRECTORY_INDEX_SIGNATURE || header.version != DIRECTORY_INDEX_VERSION) {
+    return false;
+  }
+  // checked before anything is sized by the count
+  if (header.entryCount > (size_t)(end - *data - sizeof(header)) / sizeof(DirectoryIndexEntry)) {
+    return false;
+  }
+  fingerprint->archiveSize = header.archiveSize;
+  fingerprint->lastModified = header.lastModified;
+  fingerprint->tailCrc32 = header.tailCrc32;
+  *entryCount = header.entryCount;
+  *data += sizeof(header);
+  return true;
+}
+
+bool runtime::doo::zip::core::readDirectoryIndexEntry(const uint8_t** data,
+                                                      const uint8_t* end,
+                                                      EntryInfo* entry,
+                                                      uint64_t* contentStart) {
+  DirectoryIndexEntry indexEntry;
+  if ((size_t)(end - *data) < sizeof(indexEntry)) {
+    return false;
+  }
+  memcpy(&indexEntry, *data, sizeof(indexEntry));
+  const uint8_t* filename = *data + sizeof(indexEntry);
+  if (indexEntry.record.signature != ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE ||
+      (size_t)(end - filename) < indexEntry.record.filenameLength) {
+    return false;
+  }
+  // the data can only start behind the local header
+  if (indexEntry.contentStart != 0 && 
+      indexEntry.contentStart < indexEntry.localHeaderOffset + sizeof(LocalFileHeader) + indexEntry.record.filenameLength) {
+    return false;
+  }
+  entry->record = indexEntry.record;
+  entry->filename = reinterpret_cast<const char*>(filename);
+  entry->filenameLength = indexEntry.record.filenameLength;
+  entry->compressedSize = indexEntry.compressedSize;
+  entry->uncompressedSize = indexEntry.uncompressedSize;
+  entry->localHeaderOffset = indexEntry.localHeaderOffset;
+  *contentStart = indexEntry.contentStart;
+  *data = filename + indexEntry.record.filenameLength;
+  return true;
+}
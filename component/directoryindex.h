@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "zipformat.h"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // Identifies the archive a directory index was saved for. Without a
+        // modification time only the size and the end of central directory
+        // tell archives apart, so an archive rewritten in place with the same
+        // size and the same entry count, directory size and offset and comment
+        // would still match an index saved for its old contents.
+        struct ArchiveFingerprint {
+          uint64_t archiveSize;
+          // modification time of the archive file, 0 if not known
+          uint64_t lastModified;
+          // CRC-32 of the end of central directory records
+          uint32_t tailCrc32;
+        };
+
+        bool operator==(const ArchiveFingerprint& a, const ArchiveFingerprint& b);
+
+        /************************************************************************/
+        /* A directory index is a snapshot of the parsed central directory that */
+        /* can be stored next to an archive and used instead of parsing it the  */
+        /* next time the archive is opened. A fixed size record per entry holds */
+        /* the central directory record, the 64 bit sizes and offsets and where */
+        /* the data starts, followed by the filename. It is read in place, the  */
+        /* filenames of the returned entries point into the index data.         */
+        /************************************************************************/
+
+        void appendDirectoryIndexHeader(
+          std::vector<uint8_t>* output,
+          const ArchiveFingerprint& fingerprint,
+          uint64_t entryCount
+          );
+
+        // contentStart is 0 if the entry's local header hasn't been read yet
+        void appendDirectoryIndexEntry(
+          std::vector<uint8_t>* output,
+          const EntryInfo& entry,
+          uint64_t contentStart
+          );
+
+        // Returns false if data doesn't start with a directory index header
+        // of the current version or if the rest of data is too short for the
+        // entry count it claims, *data is advanced to the first entry.
+        bool readDirectoryIndexHeader(
+          const uint8_t** data,
+          const uint8_t* end,
+          ArchiveFingerprint* fingerprint,
+          uint64_t* entryCount
+          );
+
+        // Parse the entry at *data, which is advanced to the next one.
+        // Returns false if the entry is malformed.
+        bool readDirectoryIndexEntry(
+          const uint8_t** data,
+          const uint8_t* end,
+          EntryInfo* entry,
+          uint64_t* contentStart
+          );
+      }
+    }
+  }
+}
@@ -0,0 +1,294 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "entrytable.h"
+
+using namespace runtime::doo::zip::core;
+
+// FNV-1a
+static uint32_t hashFilename(const char* filename, size_t length) {
+  uint32_t hash = 2166136261U;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(filename[i]);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+EntryTable::EntryTable() {
+}
+
+void EntryTable::Reserve(size_t entryCount) {
+  localHeaderOffsets.reserve(entryCount);
+  compressedSizes.reserve(entryCount);
+  uncompressedSizes.reserve(entryCount);
+  contentStarts.reserve(entryCount);
+  crc32s.reserve(entryCount);
+  compressionMethods.reserve(entryCount);
+  flags.reserve(entryCount);
+  filenameOffsets.reserve(entryCount);
+  filenameLengths.reserve(entryCount);
+}
+
+bool EntryTable::Add(const EntryInfo& entry, uint64_t contentStart) {
+  if (Count() >= UINT32_MAX - 1 || filenames.size() + entry.filenameLength > UINT32_MAX) {
+    return false;
+  }
+  localHeaderOffsets.push_back(entry.localHeaderOffset);
+  compressedSizes.push_back(entry.compressedSize);
+  uncompressedSizes.push_back(entry.uncompressedSize);
+  contentStarts.push_back(contentStart);
+  crc32s.push_back(entry.record.crc32);
+  compressionMethods.push_back(entry.record.compressionMethod);
+  flags.push_back(entry.record.flags);
+  filenameOffsets.push_back(static_cast<uint32_t>(filenames.size()));
+  filenameLengths.push_back(entry.filenameLength);
+  filenames.insert(filenames.end(), entry.filename, entry.filename + entry.filenameLength);
+  return true;
+}
+
+/************************************************************************/
+/* Linear probing in a table at most half full. If a filename occurs    */
+/* more than once, only the first entry is inserted, so lookups find it */
+/* just like a search from the front would.                             */
+/************************************************************************/
+void EntryTable::BuildLookup() {
+  size_t slotCount = 1;
+  while (slotCount < Count() * 2) {
+    slotCount *= 2;
+  }
+  lookup.assign(slotCount, 0);
+  size_t mask = slotCount - 1;
+  for (size_t i = 0; i < Count(); i++) {
+    size_t existing;
+    if (Find(Filename(i), FilenameLength(i), &existing)) {
+      continue;
+    }
+    size_t slot = hashFilename(Filename(i), FilenameLength(i)) & mask;
+    while (lookup[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    lookup[slot] = static_cast<uint32_t>(i + 1);
+  }
+}
+
+bool EntryTable::Find(const char* filename, size_t filenameLength, size_t* index) const {
+  if (lookup.empty()) {
+    return false;
+  }
+  size_t mask = lookup.size() - 1;
+  for (size_t slot = hashFilename(filename, filenameLength) & mask; lookup[slot] != 0; slot = (slot + 1) & mask) {
+    size_t candidate = lookup[slot] - 1;
+    if (filenameLengths[candidate] == filenameLength &&
+        memcmp(Filename(candidate), filename, filenameLength) == 0) {
+      *index = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool EntryTable::IsDirectory(size_t index) const {
+  return filenameLengths[index] > 0 && Filename(index)[filenameLengths[index] - 1] == '/';
+}
+
+EntryInfo EntryTable::Entry(size_t index) const {
+  EntryInfo entry;
+  memset(&entry.record, 0, sizeof(entry.record));
+  entry.record.signature = ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE;
+  entry.record.compressionMethod = compressionMethods[index];
+  entry.record.flags = flags[index];
+  entry.record.crc32 = crc32s[index];
+  // larger values were in the ZIP64 extra field, which isn't kept
+  entry.record.compressedSize = compressedSizes[index] < UINT32_MAX ?
+    static_cast<uint32_t>(compressedSizes[index]) : UINT32_MAX;
+  entry.record.uncompressedSize = uncompressedSizes[index] < UINT32_MAX ?
+    static_cast<uint32_t>(uncompressedSizes[index]) : UINT32_MAX;
+  entry.record.localHeaderOffset = localHeaderOffsets[index] < UINT32_MAX ?
+    static_cast<uint32_t>(localHeaderOffsets[index]) : UINT32_MAX;
+  entry.record.filenameLength = filenameLengths[index];
+  entry.filename = Filename(index);
+  entry.filenameLength = filenameLengths[index];
+  entry.compressedSize = compressedSizes[index];
+  entry.uncompressedSize = uncompressedSizes[index];
+  entry.localHeaderOffset = localHeaderOffsets[index];
+  return entry;
+}
+
+void EntryTable::Swap(EntryTable& other) {
+  localHeaderOffsets.swap(other.localHeaderOffsets);
+  compressedSizes.swap(other.compressedSizes);
+  uncompressedSizes.swap(other.uncompressedSizes);
+  contentStarts.swap(other.contentStarts);
+  crc32s.swap(other.crc32s);
+  compressionMethods.swap(other.compressionMethods);
+  flags.swap(other.flags);
+  filenameOffsets.swap(other.filenameOffsets);
+  filenameLengths.swap(other.filenameLengths);
+  filenames.swap(other.filenames);
+  lookup.swap(other.lookup);
+  sortedEntries.swap(other.sortedEntries);
+  foldedFilenames.swap(other.foldedFilenames);
+  foldedFilenameOffsets.swap(other.foldedFilenameOffsets);
+  foldedFilenameLengths.swap(other.foldedFilenameLengths);
+  foldedSortedEntries.swap(other.foldedSortedEntries);
+}
+
+bool EntryTable::NameLess(size_t a, size_t b, bool folded) const {
+  size_t lengthA = NameLength(a, folded);
+  size_t lengthB = NameLength(b, folded);
+  int order = memcmp(Name(a, folded), Name(b, folded), lengthA < lengthB ? lengthA : lengthB);
+  if (order != 0) {
+    return order < 0;
+  }
+  if (lengthA != lengthB) {
+    return lengthA < lengthB;
+  }
+  return a < b;
+}
+
+bool EntryTable::FilenameLess(size_t a, size_t b) const {
+  return NameLess(a, b, false);
+}
+
+/************************************************************************/
+/* All filenames starting with the same prefix end up next to each      */
+/* other, so everything in a folder is a contiguous range that is found */
+/* with two binary searches.                                            */
+/************************************************************************/
+void EntryTable::SortFilenames() {
+  sortedEntries.resize(Count());
+  for (size_t i = 0; i < Count(); i++) {
+    sortedEntries[i] = static_cast<uint32_t>(i);
+  }
+  std::sort(sortedEntries.begin(), sortedEntries.end(), [this](uint32_t a, uint32_t b) {
+    return NameLess(a, b, false);
+  });
+}
+
+void EntryTable::AddFoldedFilename(const char* folded, size_t foldedLength) {
+  foldedFilenameOffsets.push_back(foldedFilenames.size());
+  foldedFilenameLengths.push_back(static_cast<uint32_t>(foldedLength));
+  foldedFilenames.insert(foldedFilenames.end(), folded, folded + foldedLength);
+}
+
+void EntryTable::SortFoldedFilenames() {
+  foldedSortedEntries.resize(Count());
+  for (size_t i = 0; i < Count(); i++) {
+    foldedSortedEntries[i] = static_cast<uint32_t>(i);
+  }
+  std::sort(foldedSortedEntries.begin(), foldedSortedEntries.end(), [this](uint32_t a, uint32_t b) {
+    return NameLess(a, b, true);
+  });
+}
+
+// below 0 if the name sorts before all names starting with prefix, 0 if
+// it starts with prefix and above 0 if it sorts after them
+int EntryTable::ComparePrefix(size_t index, const char* prefix, size_t prefixLength, bool folded) const {
+  size_t length = NameLength(index, folded);
+  int order = memcmp(Name(index, folded), prefix, length < prefixLength ? length : prefixLength);
+  if (order != 0) {
+    return order;
+  }
+  return length < prefixLength ? -1 : 0;
+}
+
+// the positions in the sorted entries of the names starting with prefix
+void EntryTable::FindPrefix(const char* prefix, size_t prefixLength, bool folded, 
+                            size_t* first, size_t* end) const {
+  const std::vector<uint32_t>& sorted = folded ? foldedSortedEntries : sortedEntries;
+  size_t low = 0;
+  size_t high = sorted.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (ComparePrefix(sorted[middle], prefix, prefixLength, folded) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  *first = low;
+  high = sorted.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (ComparePrefix(sorted[middle], prefix, prefixLength, folded) <= 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  *end = low;
+}
+
+void EntryTable::NamesInFolder(const char* folder, size_t folderLength, bool recursive, bool folded,
+                               std::vector<size_t>* entries) const {
+  const std::vector<uint32_t>& sorted = folded ? foldedSortedEntries : sortedEntries;
+  size_t position, end;
+  FindPrefix(folder, folderLength, folded, &position, &end);
+  while (position < end) {
+    size_t index = sorted[position];
+    const char* name = Name(index, folded);
+    size_t nameLength = NameLength(index, folded);
+    if (isInFolder(name, nameLength, folder, folderLength, recursive)) {
+      entries->push_back(index);
+      position++;
+    } else if (nameLength == folderLength) {
+      // the folder's own entry
+      position++;
+    } else {
+      // in a subfolder, which is skipped as a whole
+      const char* slash = static_cast<const char*>(memchr(name + folderLength, '/', nameLength - folderLength));
+      size_t subfolderStart;
+      FindPrefix(name, slash - name + 1, folded, &subfolderStart, &position);
+    }
+  }
+}
+
+void EntryTable::NamesMatching(const char* pattern, size_t patternLength, bool folded,
+                               std::vector<size_t>* entries) const {
+  const std::vector<uint32_t>& sorted = folded ? foldedSortedEntries : sortedEntries;
+  size_t literalLength = 0;
+  while (literalLength < patternLength && pattern[literalLength] != '*' && pattern[literalLength] != '?') {
+    literalLength++;
+  }
+  size_t position, end;
+  FindPrefix(pattern, literalLength, folded, &position, &end);
+  for (; position < end; position++) {
+    size_t index = sorted[position];
+    if (matchGlob(pattern, patternLength, Name(index, folded), NameLength(index, folded))) {
+      entries->push_back(index);
+    }
+  }
+}
+
+void EntryTable::EntriesInFolder(const char* folder, size_t folderLength, bool recursive,
+                                 std::vector<size_t>* entries) const {
+  NamesInFolder(folder, folderLength, recursive, false, entries);
+}
+
+void EntryTable::EntriesMatching(const char* pattern, size_t patternLength,
+                                 std::vector<size_t>* entries) const {
+  NamesMatching(pattern, patternLength, false, entries);
+}
+
+// equal folded names are ordered by entry number, so the first is the lowest
+bool EntryTable::FindFolded(const char* folded, size_t foldedLength, size_t* index) const {
+  size_t first, end;
+  FindPrefix(folded, foldedLength, true, &first, &end);
+  if (first == end || foldedFilenameLengths[foldedSortedEntries[first]] != foldedLength) {
+    return false;
+  }
+  *index = foldedSortedEntries[first];
+  return true;
+}
+
+void EntryTable::FoldedEntriesInFolder(const char* folder, size_t folderLength, bool recursive,
+                                       std::vector<size_t>* entries) const {
+  NamesInFolder(folder, folderLength, recursive, true, entries);
+}
+
+void EntryTable::FoldedEntriesMatching(const char* pattern, size_t patternLength,
+                                       std::vector<size_t>* entries) const {
+  NamesMatching(pattern, patternLength, true, entries);
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "zipformat.h"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // Whether name is in folder, which is empty for the root or ends with
+        // '/'. Unless recursive, only the files and folders directly in it
+        // count. The folder's own entry isn't in it.
+        template <typename Char>
+        bool isInFolder(const Char* name, size_t nameLength, 
+                        const Char* folder, size_t folderLength, bool recursive) {
+          if (nameLength <= folderLength) {
+            return false;
+          }
+          for (size_t i = 0; i < folderLength; i++) {
+            if (name[i] != folder[i]) {
+              return false;
+            }
+          }
+          if (recursive) {
+            return true;
+          }
+          // a '/' can only be the last character, ending a folder's name
+          for (size_t i = folderLength; i < nameLength - 1; i++) {
+            if (name[i] == '/') {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        // whether c continues a character, only UTF-8 has characters of several units
+        inline bool isContinuationUnit(char c) { return (static_cast<unsigned char>(c) & 0xC0) == 0x80; }
+        inline bool isContinuationUnit(wchar_t) { return false; }
+
+        // Whether name matches pattern, where * stands for any characters but
+        // '/', ** for any characters, **/ for none or any ending with '/', and
+        // ? for one character but '/', several bytes in UTF-8. Takes time
+        // proportional to the length of the pattern times the length of the name.
+        template <typename Char>
+        bool matchGlob(const Char* pattern, size_t patternLength, const Char* name, size_t nameLength) {
+          // matched[j] is set if the pattern so far matches the first j characters
+          std::vector<char> matched(nameLength + 1, 0);
+          std::vector<char> next(nameLength + 1);
+          matched[0] = 1;
+          size_t i = 0;
+          while (i < patternLength) {
+            if (pattern[i] == '*' && i + 1 < patternLength && pattern[i + 1] == '*') {
+              bool folders = i + 2 < patternLength && pattern[i + 2] == '/';
+              // whether any of the first j characters matched
+              bool before = false;
+              for (size_t j = 0; j <= nameLength; j++) {
+                next[j] = matched[j] || (before && (!folders || name[j - 1] == '/'));
+                before = before || matched[j];
+              }
+              i += folders ? 3 : 2;
+            } else if (pattern[i] == '*') {
+              next[0] = matched[0];
+              for (size_t j = 1; j <= nameLength; j++) {
+                next[j] = matched[j] || (next[j - 1] && name[j - 1] != '/');
+              }
+              i++;
+            } else if (pattern[i] == '?') {
+              next[0] = 0;
+              // whether a character that isn't '/' started where the pattern matched
+              bool started = false;
+              for (size_t j = 1; j <= nameLength; j++) {
+                if (!isContinuationUnit(name[j - 1])) {
+                  started = matched[j - 1] && name[j - 1] != '/';
+                }
+                next[j] = started && (j == nameLength || !isContinuationUnit(name[j]));
+              }
+              i++;
+            } else {
+              next[0] = 0;
+              for (size_t j = 1; j <= nameLength; j++) {
+                next[j] = matched[j - 1] && name[j - 1] == pattern[i];
+              }
+              i++;
+            }
+            matched.swap(next);
+          }
+          return matched[nameLength] != 0;
+        }
+
+        /************************************************************************/
+        /* The entries of an archive as a structure of arrays. Each field of    */
+        /* the central directory that is used after opening lives in its own    */
+        /* contiguous array, and all filenames share one buffer, so a table of  */
+        /* any size takes a handful of allocations and about 50 bytes plus the  */
+        /* filename per entry. Filenames are kept as the bytes stored in the    */
+        /* archive, which is UTF-8 for archives that flag it. Lookups by name   */
+        /* go through an open addressing hash table of entry numbers.           */
+        /************************************************************************/
+        class EntryTable {
+        public:
+          EntryTable();
+
+          void Reserve(size_t entryCount);
+          // Append an entry. contentStart is where its data starts, 0 if the
+          // local header hasn't been read yet. Returns false if the filenames
+          // outgrow the 4 GB the table can address.
+          bool Add(const EntryInfo& entry, uint64_t contentStart);
+          // hash the filenames, after the last entry has been added
+          void BuildLookup();
+          // the first entry with the filename, false if there is none
+          bool Find(const char* filename, size_t filenameLength, size_t* index) const;
+
+          size_t Count() const { return localHeaderOffsets.size(); }
+          // not null-terminated, valid as long as the table isn't changed
+          const char* Filename(size_t index) const { return filenames.data() + filenameOffsets[index]; }
+          uint16_t FilenameLength(size_t index) const { return filenameLengths[index]; }
+          bool IsDirectory(size_t index) const;
+          uint64_t LocalHeaderOffset(size_t index) const { return localHeaderOffsets[index]; }
+          uint64_t CompressedSize(size_t index) const { return compressedSizes[index]; }
+          uint64_t UncompressedSize(size_t index) const { return uncompressedSizes[index]; }
+          uint32_t Crc32(size_t index) const { return crc32s[index]; }
+          uint16_t CompressionMethod(size_t index) const { return compressionMethods[index]; }
+          // whether the entry flags its filename as UTF-8
+          bool Utf8Filename(size_t index) const { return (flags[index] & ZipArchive_FLAG_UTF8) != 0; }
+          uint64_t ContentStart(size_t index) const { return contentStarts[index]; }
+          void SetContentStart(size_t index, uint64_t start) { contentStarts[index] = start; }
+
+          // The entry as readCentralDirectoryEntry would return it. Only the
+          // fields kept in the table are set in the record, the rest are 0.
+          EntryInfo Entry(size_t index) const;
+
+          // Sort the filenames for the queries below, after the last entry
+          // has been added. The queries take time proportional to the number
+          // of entries they return, or, for patterns, to the number starting
+          // with the pattern's part in front of the first wildcard. Both
+          // return the entries ordered by filename.
+          void SortFilenames();
+          bool FilenamesSorted() const { return sortedEntries.size() == Count(); }
+          // folder is empty for the root or ends with '/', see isInFolder
+          void EntriesInFolder(const char* folder, size_t folderLength, bool recursive, 
+                               std::vector<size_t>* entries) const;
+          // see matchGlob
+          void EntriesMatching(const char* pattern, size_t patternLength, 
+                               std::vector<size_t>* entries) const;
+          // byte by byte, and in archive order for equal filenames
+          bool FilenameLess(size_t a, size_t b) const;
+
+          // Case insensitive queries run on a second set of filenames, folded
+          // by the caller and encoded like the names they are queried with.
+          // Add one per entry in entry order, after the last entry has been
+          // added, then sort them. Every entry is kept, so entries whose names
+          // only differ in case are all found, the lookup returns the first.
+          void AddFoldedFilename(const char* folded, size_t foldedLength);
+          void SortFoldedFilenames();
+          bool FoldedFilenamesSorted() const { return foldedSortedEntries.size() == Count(); }
+          bool FindFolded(const char* folded, size_t foldedLength, size_t* index) const;
+          // like EntriesInFolder and EntriesMatching, ordered by folded name
+          void FoldedEntriesInFolder(const char* folder, size_t folderLength, bool recursive, 
+                                     std::vector<size_t>* entries) const;
+          void FoldedEntriesMatching(const char* pattern, size_t patternLength, 
+                                     std::vector<size_t>* entries) const;
+
+          void Swap(EntryTable& other);
+
+        private:
+          EntryTable(const EntryTable&);
+          EntryTable& operator=(const EntryTable&);
+
+          std::vector<uint64_t> localHeaderOffsets;
+          std::vector<uint64_t> compressedSizes;
+          std::vector<uint64_t> uncompressedSizes;
+          std::vector<uint64_t> contentStarts;
+          std::vector<uint32_t> crc32s;
+          std::vector<uint16_t> compressionMethods;
+          std::vector<uint16_t> flags;
+          std::vector<uint32_t> filenameOffsets;
+          std::vector<uint16_t> filenameLengths;
+          std::vector<char> filenames;
+          // entry number + 1 per slot, 0 for empty slots, size a power of 2
+          std::vector<uint32_t> lookup;
+          // entry numbers ordered by filename, empty until sorted
+          std::vector<uint32_t> sortedEntries;
+          // folded filenames in one buffer, and the entry numbers ordered by them
+          std::vector<char> foldedFilenames;
+          std::vector<size_t> foldedFilenameOffsets;
+          std::vector<uint32_t> foldedFilenameLengths;
+          std::vector<uint32_t> foldedSortedEntries;
+
+          // the name the queries work on, the filename or its folded version
+          const char* Name(size_t index, bool folded) const {
+            return folded ? foldedFilenames.data() + foldedFilenameOffsets[index] : Filename(index);
+          }
+          size_t NameLength(size_t index, bool folded) const {
+            return folded ? foldedFilenameLengths[index] : filenameLengths[index];
+          }
+          bool NameLess(size_t a, size_t b, bool folded) const;
+          int ComparePrefix(size_t index, const char* prefix, size_t prefixLength, bool folded) const;
+          void FindPrefix(const char* prefix, size_t prefixLength, bool folded, size_t* first, size_t* end) const;
+          void NamesInFolder(const char* folder, size_t folderLength, bool recursive, bool folded,
+                             std::vector<size_t>* entries) const;
+          void NamesMatching(const char* pattern, size_t patternLength, bool folded,
+                             std::vector<size_t>* entries) const;
+        };
+      }
+    }
+  }
+}
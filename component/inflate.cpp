@@ -0,0 +1,191 @@
+// the tinfl implementation is compiled into this translation unit only
+#include "tinfl.c"
+
+#include <algorithm>
+#include <memory>
+
+#include "crc32.h"
+#include "inflate.h"
+#include "inflateindex.h"
+
+using namespace runtime::doo::zip::core;
+
+// idle inflaters kept for reuse, enough for one per core on most machines
+#define INFLATER_POOL_SIZE 16
+
+static Pool<Inflater> inflaterPool(INFLATER_POOL_SIZE);
+
+Inflater::Inflater() {
+  Reset();
+}
+
+Inflater::Inflater(uint8_t* output, size_t outputLength) {
+  Reset(output, outputLength);
+}
+
+Inflater::Inflater(const InflateCheckpoint& checkpoint) {
+  Reset(checkpoint);
+}
+
+void Inflater::Reset() {
+  Reset(nullptr, 0);
+  usingDictionary = true;
+}
+
+void Inflater::Reset(uint8_t* output, size_t outputLength) {
+  usingDictionary = false;
+  outputStart = output;
+  this->outputLength = outputLength;
+  outputOffset = 0;
+  crc = 0;
+  totalIn = 0;
+  totalOut = 0;
+  checkpointIndex = nullptr;
+  tinfl_init(&decompressor);
+}
+
+/************************************************************************/
+/* The window goes to the end of the dictionary, so output continues at */
+/* its start and distances reach back into the window across the wrap.  */
+/************************************************************************/
+void Inflater::Reset(const InflateCheckpoint& checkpoint) {
+  Reset();
+  totalIn = checkpoint.inputOffset;
+  totalOut = checkpoint.outputOffset;
+  memset(dictionary, 0, sizeof(dictionary));
+  size_t windowLength = std::min(checkpoint.window.size(), sizeof(dictionary));
+  if (windowLength > 0) {
+    memcpy(dictionary + sizeof(dictionary) - windowLength,
+      checkpoint.window.data() + checkpoint.window.size() - windowLength, windowLength);
+  }
+  tinfl_init_at_block(&decompressor, checkpoint.bits, checkpoint.bitCount);
+}
+
+/************************************************************************/
+/* A block is about to start. The bits tinfl has read ahead tell where   */
+/* it starts in the input, the output in front of it is the window.     */
+/************************************************************************/
+void Inflater::RecordCheckpoint(size_t outputPosition, uint64_t outputOffset) {
+  if (!checkpointIndex->WantsCheckpoint(outputOffset)) {
+    return;
+  }
+  std::shared_ptr<InflateCheckpoint> checkpoint = std::make_shared<InflateCheckpoint>();
+  uint64_t bitPosition = totalIn * 8 - decompressor.m_num_bits;
+  checkpoint->outputOffset = outputOffset;
+  checkpoint->inputOffset = (bitPosition + 7) / 8;
+  checkpoint->bitCount = static_cast<uint8_t>(checkpoint->inputOffset * 8 - bitPosition);
+  checkpoint->bits = static_cast<uint8_t>(decompressor.m_bit_buf & ((1U << checkpoint->bitCount) - 1));
+
+  size_t windowLength = static_cast<size_t>(std::min(outputOffset, (uint64_t)TINFL_LZ_DICT_SIZE));
+  checkpoint->window.resize(windowLength);
+  if (usingDictionary) {
+    for (size_t i = 0; i < windowLength; i++) {
+      checkpoint->window[i] = dictionary[(outputPosition - windowLength + i) & (TINFL_LZ_DICT_SIZE - 1)];
+    }
+  } else if (windowLength > 0) {
+    memcpy(checkpoint->window.data(), outputStart + outputPosition - windowLength, windowLength);
+  }
+  checkpointIndex->AddCheckpoint(checkpoint);
+}
+
+tinfl_status Inflater::Inflate(const uint8_t* input,
+                               size_t* inputSize,
+                               bool hasMoreInput,
+                               const uint8_t** output,
+                               size_t* outputSize) {
+  uint8_t* start;
+  size_t available;
+  mz_uint32 flags = hasMoreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0;
+  if (checkpointIndex != nullptr) {
+    flags |= TINFL_FLAG_STOP_AT_BLOCK_BOUNDARY;
+  }
+  if (usingDictionary) {
+    start = dictionary;
+    available = TINFL_LZ_DICT_SIZE - outputOffset;
+  } else {
+    start = outputStart;
+    available = outputLength - outputOffset;
+    flags |= TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+  }
+  if (available > INFLATE_OUTPUT_CHUNK_SIZE) {
+    available = INFLATE_OUTPUT_CHUNK_SIZE;
+  }
+
+  uint8_t* next = start + outputOffset;
+  size_t consumed = 0, produced = 0;
+  tinfl_status status;
+  for (;;) {
+    size_t inputPiece = *inputSize - consumed;
+    size_t outputPiece = available - produced;
+    status = tinfl_decompress(
+      &decompressor, input + consumed, &inputPiece, start, next + produced, &outputPiece, flags);
+    consumed += inputPiece;
+    produced += outputPiece;
+    totalIn += inputPiece;
+    if (status != TINFL_STATUS_BLOCK_BOUNDARY) {
+      break;
+    }
+    RecordCheckpoint(outputOffset + produced, totalOut + produced);
+  }
+  *inputSize = consumed;
+  available = produced;
+
+  crc = updateCrc32(crc, next, available);
+  totalOut += available;
+  *output = next;
+  *outputSize = available;
+  outputOffset += available;
+  if (usingDictionary) {
+    outputOffset &= TINFL_LZ_DICT_SIZE - 1;
+  }
+  return status;
+}
+
+PooledInflater runtime::doo::zip::core::acquireInflater() {
+  PooledInflater inflater = inflaterPool.Take();
+  if (!inflater) {
+    return inflaterPool.Adopt(new Inflater());
+  }
+  inflater->Reset();
+  return inflater;
+}
+
+PooledInflater runtime::doo::zip::core::acquireInflater(uint8_t* output, size_t outputLength) {
+  PooledInflater inflater = inflaterPool.Take();
+  if (!inflater) {
+    return inflaterPool.Adopt(new Inflater(output, outputLength));
+  }
+  inflater->Reset(output, outputLength);
+  return inflater;
+}
+
+PooledInflater runtime::doo::zip::core::acquireInflater(const InflateCheckpoint& checkpoint) {
+  PooledInflater inflater = inflaterPool.Take();
+  if (!inflater) {
+    return inflaterPool.Adopt(new Inflater(checkpoint));
+  }
+  inflater->Reset(checkpoint);
+  return inflater;
+}
+
+bool runtime::doo::zip::core::inflateToSpan(const uint8_t* input,
+                                            size_t inputLength,
+                                            uint8_t* output,
+                                            size_t outputLength,
+                                            uint32_t* crc) {
+  PooledInflater inflater = acquireInflater(output, outputLength);
+  tinfl_status status;
+  do {
+    size_t inputSize = inputLength;
+    const uint8_t* inflated;
+    size_t inflatedSize;
+    status = inflater->Inflate(input, &inputSize, false, &inflated, &inflatedSize);
+    input += inputSize;
+    inputLength -= inputSize;
+  } while (status == TINFL_STATUS_HAS_MORE_OUTPUT && inflater->TotalOut() < outputLength);
+
+  if (crc != nullptr) {
+    *crc = inflater->Crc32();
+  }
+  return status == TINFL_STATUS_DONE && inflater->TotalOut() == outputLength;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+#define TINFL_HEADER_FILE_ONLY
+#include "tinfl.c"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        struct InflateCheckpoint;
+        class InflateIndex;
+
+        // Upper bound for the output handed out by a single Inflate() call,
+        // small enough for each chunk to still be in cache when it's checksummed.
+        // Callers that check for cancellation between calls react within this.
+        const size_t INFLATE_OUTPUT_CHUNK_SIZE = 256 * 1024;
+
+        /************************************************************************/
+        /* Incremental decompression of a raw DEFLATE stream on top of the      */
+        /* tinfl_decompress coroutine. Input can be supplied in arbitrary       */
+        /* pieces. The output either goes to an internal 32 KB dictionary and   */
+        /* is handed out chunk by chunk, or straight into a caller provided     */
+        /* buffer that is large enough for the whole stream. The CRC-32 of the  */
+        /* output is computed on the fly.                                       */
+        /************************************************************************/
+        class Inflater {
+        public:
+          // inflate into the internal dictionary
+          Inflater();
+          // inflate straight into output
+          Inflater(uint8_t* output, size_t outputLength);
+          // Continue a stream at a checkpoint, into the internal dictionary.
+          // Input has to start at the checkpoint's input offset, the offsets
+          // count on from the checkpoint and the CRC-32 only covers the
+          // output from there on.
+          explicit Inflater(const InflateCheckpoint& checkpoint);
+
+          // start over with a new stream, like the constructor with the same
+          // arguments, keeping the memory for decompressor and dictionary
+          void Reset();
+          void Reset(uint8_t* output, size_t outputLength);
+          void Reset(const InflateCheckpoint& checkpoint);
+
+          // Add a checkpoint to index whenever a block starts at least the
+          // index's spacing after the previous checkpoint
+          void RecordCheckpoints(InflateIndex* index) { checkpointIndex = index; }
+
+          // Decompress as much of input as possible. On return *inputSize holds
+          // the number of bytes consumed and output/outputSize the bytes inflated
+          // by this call, which stay valid until the next call.
+          tinfl_status Inflate(
+            const uint8_t* input,
+            size_t* inputSize,
+            bool hasMoreInput,
+            const uint8_t** output,
+            size_t* outputSize
+            );
+
+          uint32_t Crc32() const { return crc; }
+          uint64_t TotalIn() const { return totalIn; }
+          uint64_t TotalOut() const { return totalOut; }
+
+        private:
+          Inflater(const Inflater&);
+          Inflater& operator=(const Inflater&);
+
+          void RecordCheckpoint(size_t outputPosition, uint64_t outputOffset);
+
+          tinfl_decompressor decompressor;
+          bool usingDictionary;
+          uint8_t* outputStart;
+          size_t outputLength;
+          size_t outputOffset;
+          uint32_t crc;
+          uint64_t totalIn;
+          uint64_t totalOut;
+          InflateIndex* checkpointIndex;
+          uint8_t dictionary[TINFL_LZ_DICT_SIZE];
+        };
+
+        // An Inflater is over 40 KB, mostly decompressor tables and dictionary,
+        // so instead of allocating one per entry they are taken from a pool
+        // and returned to it when the pointer is released. Arguments are the
+        // same as for the constructors.
+        typedef Pool<Inflater>::Pointer PooledInflater;
+        PooledInflater acquireInflater();
+        PooledInflater acquireInflater(uint8_t* output, size_t outputLength);
+        PooledInflater acquireInflater(const InflateCheckpoint& checkpoint);
+
+        // Inflate a raw DEFLATE stream held in memory into a caller provided span.
+        // Returns true if the stream decodes to exactly outputLength bytes, crc
+        // (if given) receives the CRC-32 of the output.
+        bool inflateToSpan(
+          const uint8_t* input,
+          size_t inputLength,
+          uint8_t* output,
+          size_t outputLength,
+          uint32_t* crc
+          );
+      }
+    }
+  }
+}
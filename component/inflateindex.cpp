@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "inflateindex.h"
+
+using namespace runtime::doo::zip::core;
+
+// "ZIDX" followed by the format version
+#define INFLATE_INDEX_SIGNATURE 0x5844495A
+#define INFLATE_INDEX_VERSION 1
+#define INFLATE_INDEX_MAX_WINDOW 32768
+
+InflateIndex::InflateIndex() :
+  spacing(0),
+  compressedSize(0),
+  uncompressedSize(0),
+  crc32(0) {
+}
+
+InflateIndex::InflateIndex(uint64_t spacing, uint64_t compressedSize, uint64_t uncompressedSize, uint32_t crc32) :
+  spacing(spacing),
+  compressedSize(compressedSize),
+  uncompressedSize(uncompressedSize),
+  crc32(crc32) {
+}
+
+bool InflateIndex::Matches(uint64_t compressedSize, uint64_t uncompressedSize, uint32_t crc32) const {
+  return this->compressedSize == compressedSize &&
+    this->uncompressedSize == uncompressedSize &&
+    this->crc32 == crc32;
+}
+
+std::shared_ptr<const InflateCheckpoint> InflateIndex::FindCheckpoint(uint64_t outputOffset) const {
+  auto next = std::upper_bound(checkpoints.begin(), checkpoints.end(), outputOffset,
+    [](uint64_t offset, const std::shared_ptr<const InflateCheckpoint>& checkpoint) {
+      return offset < checkpoint->outputOffset;
+  });
+  if (next == checkpoints.begin()) {
+    return nullptr;
+  }
+  return *(next - 1);
+}
+
+bool InflateIndex::WantsCheckpoint(uint64_t outputOffset) const {
+  uint64_t last = checkpoints.empty() ? 0 : checkpoints.back()->outputOffset;
+  return spacing > 0 && outputOffset >= last + spacing;
+}
+
+void InflateIndex::AddCheckpoint(const std::shared_ptr<const InflateCheckpoint>& checkpoint) {
+  checkpoints.push_back(checkpoint);
+}
+
+static void appendValue(std::vector<uint8_t>* output, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    output->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+static bool readValue(const uint8_t** data, const uint8_t* end, size_t size, uint64_t* value) {
+  if ((size_t)(end - *data) < size) {
+    return false;
+  }
+  *value = 0;
+  for (size_t i = 0; i < size; i++) {
+    *value |= (uint64_t)(*data)[i] << (8 * i);
+  }
+  *data += size;
+  return true;
+}
+
+/************************************************************************/
+/* Little endian header with the entry's sizes and CRC-32, followed by  */
+/* the checkpoints with their windows.                                  */
+/************************************************************************/
+void InflateIndex::Serialize(std::vector<uint8_t>* output) const {
+  appendValue(output, INFLATE_INDEX_SIGNATURE, 4);
+  appendValue(output, INFLATE_INDEX_VERSION, 2);
+  appendValue(output, spacing, 8);
+  appendValue(output, compressedSize, 8);
+  appendValue(output, uncompressedSize, 8);
+  appendValue(output, crc32, 4);
+  appendValue(output, checkpoints.size(), 4);
+  for (size_t i = 0; i < checkpoints.size(); i++) {
+    const InflateCheckpoint& checkpoint = *checkpoints[i];
+    appendValue(output, checkpoint.outputOffset, 8);
+    appendValue(output, checkpoint.inputOffset, 8);
+    appendValue(output, checkpoint.bitCount, 1);
+    appendValue(output, checkpoint.bits, 1);
+    appendValue(output, checkpoint.window.size(), 4);
+    output->insert(output->end(), checkpoint.window.begin(), checkpoint.window.end());
+  }
+}
+
+bool InflateIndex::Deserialize(const uint8_t* data, size_t length, InflateIndex* index) {
+  const uint8_t* end = data + length;
+  uint64_t signature, version, crc, count;
+  InflateIndex result;
+  if (!readValue(&data, end, 4, &signature) || signature != INFLATE_INDEX_SIGNATURE ||
+      !readValue(&data, end, 2, &version) || version != INFLATE_INDEX_VERSION ||
+      !readValue(&data, end, 8, &result.spacing) ||
+      !readValue(&data, end, 8, &result.compressedSize) ||
+      !readValue(&data, end, 8, &result.uncompressedSize) ||
+      !readValue(&data, end, 4, &crc) ||
+      !readValue(&data, end, 4, &count)) {
+    return false;
+  }
+  result.crc32 = static_cast<uint32_t>(crc);
+  for (uint64_t i = 0; i < count; i++) {
+    std::shared_ptr<InflateCheckpoint> checkpoint = std::make_shared<InflateCheckpoint>();
+    uint64_t bitCount, bits, windowLength;
+    if (!readValue(&data, end, 8, &checkpoint->outputOffset) ||
+        !readValue(&data, end, 8, &checkpoint->inputOffset) ||
+        !readValue(&data, end, 1, &bitCount) || bitCount > 7 ||
+        !readValue(&data, end, 1, &bits) ||
+        !readValue(&data, end, 4, &windowLength) ||
+        windowLength > INFLATE_INDEX_MAX_WINDOW ||
+        windowLength > checkpoint->outputOffset ||
+        (size_t)(end - data) < windowLength) {
+      return false;
+    }
+    // checkpoints have to be ordered and lie within the entry
+    if (checkpoint->outputOffset > result.uncompressedSize ||
+        checkpoint->inputOffset > result.compressedSize ||
+        (!result.checkpoints.empty() && checkpoint->outputOffset <= result.checkpoints.back()->outputOffset)) {
+      return false;
+    }
+    checkpoint->bitCount = static_cast<uint8_t>(bitCount);
+    checkpoint->bits = static_cast<uint8_t>(bits);
+    checkpoint->window.assign(data, data + windowLength);
+    data += windowLength;
+    result.checkpoints.push_back(checkpoint);
+  }
+  *index = result;
+  return true;
+}
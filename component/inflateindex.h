@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // A point at a block boundary of a DEFLATE stream that decompression
+        // can be resumed from
+        struct InflateCheckpoint {
+          // where the block starts in the uncompressed data
+          uint64_t outputOffset;
+          // the first compressed byte not read yet when the block starts
+          uint64_t inputOffset;
+          // bits of the byte before inputOffset that belong to the block, in
+          // the lowest bitCount bits of bits
+          uint8_t bitCount;
+          uint8_t bits;
+          // the up to 32 KB of output preceding the block
+          std::vector<uint8_t> window;
+        };
+
+        /************************************************************************/
+        /* Checkpoints into one deflated entry, in the manner of zlib's zran    */
+        /* example. They are recorded about every spacing bytes of output while */
+        /* the entry is inflated, so later reads of a range only need to        */
+        /* inflate from the checkpoint in front of it. The index remembers the  */
+        /* sizes and CRC-32 of the entry it was built for, so a serialized      */
+        /* index can be checked before it's reused.                             */
+        /************************************************************************/
+        class InflateIndex {
+        public:
+          InflateIndex();
+          InflateIndex(uint64_t spacing, uint64_t compressedSize, uint64_t uncompressedSize, uint32_t crc32);
+
+          uint64_t Spacing() const { return spacing; }
+          bool Matches(uint64_t compressedSize, uint64_t uncompressedSize, uint32_t crc32) const;
+
+          size_t CheckpointCount() const { return checkpoints.size(); }
+          // the last checkpoint at or before outputOffset, null if there is none
+          std::shared_ptr<const InflateCheckpoint> FindCheckpoint(uint64_t outputOffset) const;
+          // whether a block starting at outputOffset should get a checkpoint
+          bool WantsCheckpoint(uint64_t outputOffset) const;
+          // checkpoints have to be added in order of their output offset
+          void AddCheckpoint(const std::shared_ptr<const InflateCheckpoint>& checkpoint);
+
+          // Append the index to output in a portable format, and read it back.
+          // Deserialize() returns false if the data isn't a valid index.
+          void Serialize(std::vector<uint8_t>* output) const;
+          static bool Deserialize(const uint8_t* data, size_t length, InflateIndex* index);
+
+        private:
+          uint64_t spacing;
+          uint64_t compressedSize;
+          uint64_t uncompressedSize;
+          uint32_t crc32;
+          std::vector<std::shared_ptr<const InflateCheckpoint>> checkpoints;
+        };
+      }
+    }
+  }
+}
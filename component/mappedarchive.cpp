@@ -0,0 +1,280 @@
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "crc32.h"
+#include "inflate.h"
+#include "mappedarchive.h"
+
+using namespace runtime::doo::zip::core;
+
+#ifdef _WIN32
+MappedFile::MappedFile(const char* path) :
+  data(nullptr),
+  size(0),
+  fileHandle(INVALID_HANDLE_VALUE),
+  mappingHandle(nullptr) {
+  fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error(std::string("Could not open file ") + path);
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize) || (uint64_t)fileSize.QuadPart > SIZE_MAX) {
+    CloseHandle(fileHandle);
+    throw std::runtime_error(std::string("Could not map file ") + path);
+  }
+  size = static_cast<size_t>(fileSize.QuadPart);
+  if (size > 0) {
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr) {
+      data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (data == nullptr) {
+      if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+      }
+      CloseHandle(fileHandle);
+      throw std::runtime_error(std::string("Could not map file ") + path);
+    }
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+  }
+  CloseHandle(fileHandle);
+}
+#else
+MappedFile::MappedFile(const char* path) :
+  data(nullptr),
+  size(0) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Could not open file ") + path);
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || (uint64_t)status.st_size > SIZE_MAX) {
+    close(fd);
+    throw std::runtime_error(std::string("Could not map file ") + path);
+  }
+  size = static_cast<size_t>(status.st_size);
+  if (size > 0) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(std::string("Could not map file ") + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+  }
+  // the mapping keeps the file referenced
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data != nullptr) {
+    munmap(const_cast<uint8_t*>(data), size);
+  }
+}
+#endif
+
+bool MappedArchive::FilenameKey::operator==(const FilenameKey& other) const {
+  return length == other.length && memcmp(data, other.data, length) == 0;
+}
+
+// FNV-1a over the raw filename bytes
+size_t MappedArchive::FilenameHash::operator()(const FilenameKey& key) const {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < key.length; i++) {
+    hash = (hash ^ static_cast<uint8_t>(key.data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+/************************************************************************/
+/* Map the file and parse the central directory where it lies. Only the */
+/* EntryInfo structs are allocated, filenames stay in the mapping.      */
+/************************************************************************/
+MappedArchive::MappedArchive(const char* path) :
+  file(path) {
+  const uint8_t* data = file.Data();
+  size_t size = file.Size();
+
+  // the end of central directory record may be followed by a comment of up to 64 KB
+  size_t tailLength = sizeof(EndOfCentralDirectoryRecord) + UINT16_MAX;
+  if (tailLength > size) {
+    tailLength = size;
+  }
+  CentralDirectoryLocation location;
+  if (!readEndOfCentralDirectory(data + size - tailLength, tailLength, &location)) {
+    throw std::runtime_error("Could not read ZIP file");
+  }
+  if (location.hasZip64Record) {
+    if (location.zip64RecordOffset > size ||
+        !readZip64EndOfCentralDirectory(data + location.zip64RecordOffset,
+          static_cast<size_t>(size - location.zip64RecordOffset), &location)) {
+      throw std::runtime_error("Could not read ZIP64 end of central directory");
+    }
+  }
+  if (location.offset > size || location.size > size - location.offset) {
+    throw std::runtime_error("Could not read ZIP file");
+  }
+
+  const uint8_t* record = data + location.offset;
+  const uint8_t* recordsEnd = record + location.size;
+  // every record takes at least its fixed part, so a bogus count can't reserve too much
+  entries.reserve(static_cast<size_t>(
+    location.entryCount < location.size / sizeof(CentralDirectoryRecord) ?
+    location.entryCount : location.size / sizeof(CentralDirectoryRecord)));
+  entryIndex.reserve(entries.capacity());
+  for (uint64_t i = 0; i < location.entryCount; i++) {
+    EntryInfo entry;
+    if (!readCentralDirectoryEntry(&record, recordsEnd, &entry)) {
+      throw std::runtime_error("Invalid ZIP file entry header");
+    }
+    FilenameKey key = { entry.filename, entry.filenameLength };
+    entryIndex.insert(std::make_pair(key, entries.size()));
+    entries.push_back(entry);
+  }
+}
+
+const EntryInfo* MappedArchive::FindEntry(const char* filename, size_t length) const {
+  FilenameKey key = { filename, length };
+  auto found = entryIndex.find(key);
+  return found != entryIndex.end() ? &entries[found->second] : nullptr;
+}
+
+/************************************************************************/
+/* Check the local header against the central directory and return      */
+/* where the entry's data starts in the mapping                         */
+/************************************************************************/
+const uint8_t* MappedArchive::CompressedData(const EntryInfo& entry) const {
+  const uint8_t* data = file.Data();
+  size_t size = file.Size();
+  std::string filename(entry.filename, entry.filenameLength);
+
+  LocalFileHeader localHeader;
+  if (entry.localHeaderOffset > size ||
+      !readLocalHeader(data + entry.localHeaderOffset,
+        static_cast<size_t>(size - entry.localHeaderOffset), &localHeader)) {
+    throw std::runtime_error("Invalid local header: " + filename);
+  }
+  uint64_t contentStart = entry.localHeaderOffset
+    + sizeof(LocalFileHeader)
+    + localHeader.filenameLength
+    + localHeader.extraFieldLength;
+  if (contentStart > size || entry.compressedSize > size - contentStart) {
+    throw std::runtime_error("Entry exceeds the end of the ZIP file: " + filename);
+  }
+  if (localHeader.filenameLength != entry.filenameLength ||
+      memcmp(data + entry.localHeaderOffset + sizeof(LocalFileHeader),
+        entry.filename, entry.filenameLength) != 0) {
+    throw std::runtime_error("Filename in local header does not match: " + filename);
+  }
+  return data + contentStart;
+}
+
+const uint8_t* MappedArchive::StoredData(const EntryInfo& entry) const {
+  if (entry.record.compressionMethod != 0 || entry.compressedSize != entry.uncompressedSize) {
+    throw std::runtime_error("Entry is compressed: " + std::string(entry.filename, entry.filenameLength));
+  }
+  return CompressedData(entry);
+}
+
+void MappedArchive::VerifyEntry(const EntryInfo& entry) const {
+  const uint8_t* data = StoredData(entry);
+  if (updateCrc32(0, data, static_cast<size_t>(entry.uncompressedSize)) != entry.record.crc32) {
+    throw std::runtime_error("CRC-32 mismatch, file is corrupt: " + std::string(entry.filename, entry.filenameLength));
+  }
+}
+
+void MappedArchive::ReadEntry(const EntryInfo& entry, uint8_t* output, size_t outputLength) const {
+  std::string filename(entry.filename, entry.filenameLength);
+  if (outputLength != entry.uncompressedSize) {
+    throw std::runtime_error("Output size does not match: " + filename);
+  }
+  const uint8_t* input = CompressedData(entry);
+  uint32_t crc;
+  switch (entry.record.compressionMethod) {
+  case 0: // stored
+    if (entry.compressedSize != entry.uncompressedSize) {
+      throw std::runtime_error("Could not extract data for file " + filename);
+    }
+    memcpy(output, input, outputLength);
+    crc = updateCrc32(0, output, outputLength);
+    break;
+  case 8: // deflate
+    if (!inflateToSpan(input, static_cast<size_t>(entry.compressedSize), output, outputLength, &crc)) {
+      throw std::runtime_error("Could not extract data for file " + filename);
+    }
+    break;
+  default:
+    throw std::runtime_error("Compression algorithm not supported: " + filename);
+  }
+  if (crc != entry.record.crc32) {
+    throw std::runtime_error("CRC-32 mismatch, file is corrupt: " + filename);
+  }
+}
+
+void MappedArchive::ReadEntry(const EntryInfo& entry,
+                              const std::function<void(const uint8_t*, size_t)>& consumeOutput) const {
+  std::string filename(entry.filename, entry.filenameLength);
+  const uint8_t* input = CompressedData(entry);
+  uint32_t crc = 0;
+  switch (entry.record.compressionMethod) {
+  case 0: { // stored, hand out the mapping in cache sized pieces
+    if (entry.compressedSize != entry.uncompressedSize) {
+      throw std::runtime_error("Could not extract data for file " + filename);
+    }
+    uint64_t remaining = entry.uncompressedSize;
+    while (remaining > 0) {
+      size_t length = static_cast<size_t>(
+        remaining < INFLATE_OUTPUT_CHUNK_SIZE ? remaining : INFLATE_OUTPUT_CHUNK_SIZE);
+      crc = updateCrc32(crc, input, length);
+      consumeOutput(input, length);
+      input += length;
+      remaining -= length;
+    }
+    break;
+  }
+  case 8: { // deflate, the whole compressed stream is available at once
+    PooledInflater inflater = acquireInflater();
+    size_t inputAvailable = static_cast<size_t>(entry.compressedSize);
+    tinfl_status status;
+    do {
+      size_t inputSize = inputAvailable;
+      const uint8_t* output;
+      size_t outputSize;
+      status = inflater->Inflate(input, &inputSize, false, &output, &outputSize);
+      input += inputSize;
+      inputAvailable -= inputSize;
+      if (outputSize > 0) {
+        consumeOutput(output, outputSize);
+      }
+    } while (status == TINFL_STATUS_HAS_MORE_OUTPUT && inflater->TotalOut() < entry.uncompressedSize);
+    if (status != TINFL_STATUS_DONE || inflater->TotalOut() != entry.uncompressedSize) {
+      throw std::runtime_error("Could not extract data for file " + filename);
+    }
+    crc = inflater->Crc32();
+    break;
+  }
+  default:
+    throw std::runtime_error("Compression algorithm not supported: " + filename);
+  }
+  if (crc != entry.record.crc32) {
+    throw std::runtime_error("CRC-32 mismatch, file is corrupt: " + filename);
+  }
+}
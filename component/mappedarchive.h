@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "zipformat.h"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        /************************************************************************/
+        /* A read-only view of a whole file in memory. Uses mmap on POSIX       */
+        /* systems and file mappings on the Windows desktop; Windows Store      */
+        /* apps can't map files and use the stream based ZipArchive instead.    */
+        /************************************************************************/
+        class MappedFile {
+        public:
+          explicit MappedFile(const char* path);
+          ~MappedFile();
+
+          const uint8_t* Data() const { return data; }
+          size_t Size() const { return size; }
+
+        private:
+          MappedFile(const MappedFile&);
+          MappedFile& operator=(const MappedFile&);
+
+          const uint8_t* data;
+          size_t size;
+#ifdef _WIN32
+          void* fileHandle;
+          void* mappingHandle;
+#endif
+        };
+
+        /************************************************************************/
+        /* Read-only archive backend on top of a memory mapped file. The        */
+        /* central directory is parsed in place, filenames point into the      */
+        /* mapping, compressed data is inflated straight from the mapping and  */
+        /* stored entries are handed out as views without any copy. Errors     */
+        /* are reported as std::runtime_error.                                  */
+        /************************************************************************/
+        class MappedArchive {
+        public:
+          explicit MappedArchive(const char* path);
+
+          size_t EntryCount() const { return entries.size(); }
+          const EntryInfo& Entry(size_t index) const { return entries[index]; }
+
+          // the first entry with that filename, nullptr if there is none
+          const EntryInfo* FindEntry(const char* filename, size_t length) const;
+
+          // The stored bytes of an uncompressed entry as a view into the
+          // mapping, valid for the lifetime of the archive. The CRC-32 is not
+          // checked, call VerifyEntry() if the data isn't trusted.
+          const uint8_t* StoredData(const EntryInfo& entry) const;
+
+          // Decompress an entry into output, which has to hold exactly
+          // entry.uncompressedSize bytes. The CRC-32 is verified.
+          void ReadEntry(const EntryInfo& entry, uint8_t* output, size_t outputLength) const;
+
+          // Decompress an entry piece by piece, for entries that are written
+          // somewhere else instead of being held in memory
+          void ReadEntry(
+            const EntryInfo& entry,
+            const std::function<void(const uint8_t*, size_t)>& consumeOutput
+            ) const;
+
+          // check the CRC-32 of a stored entry
+          void VerifyEntry(const EntryInfo& entry) const;
+
+        private:
+          struct FilenameKey {
+            const char* data;
+            size_t length;
+            bool operator==(const FilenameKey& other) const;
+          };
+          struct FilenameHash {
+            size_t operator()(const FilenameKey& key) const;
+          };
+
+          const uint8_t* CompressedData(const EntryInfo& entry) const;
+
+          MappedFile file;
+          std::vector<EntryInfo> entries;
+          std::unordered_map<FilenameKey, size_t, FilenameHash> entryIndex;
+        };
+      }
+    }
+  }
+}
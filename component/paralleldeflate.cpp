@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "crc32.h"
+#include "paralleldeflate.h"
+
+using namespace runtime::doo::zip::core;
+
+// a block can refer back this far into the one before it
+#define PARALLEL_DEFLATE_DICTIONARY_SIZE (32 * 1024)
+
+ParallelDeflater::ParallelDeflater(int level, unsigned int threadCount) :
+  level(level),
+  stopping(false),
+  finished(false),
+  crc(0),
+  totalIn(0),
+  totalOut(0) {
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  // enough to keep every worker busy while finished blocks wait to be written
+  maxBlocksInFlight = 2 * threadCount;
+  input.reserve(PARALLEL_DEFLATE_BLOCK_SIZE);
+  for (unsigned int i = 0; i < threadCount; i++) {
+    workers.push_back(std::thread([this]() {
+      CompressBlocks();
+    }));
+  }
+}
+
+ParallelDeflater::~ParallelDeflater() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  blockQueued.notify_all();
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+void ParallelDeflater::Reset(int level) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queuedBlocks.clear();
+  }
+  this->level = level;
+  pendingBlocks.clear();
+  input.clear();
+  dictionary.clear();
+  finished = false;
+  crc = 0;
+  totalIn = 0;
+  totalOut = 0;
+}
+
+/************************************************************************/
+/* Worker loop: take the next queued block and compress it on its own,  */
+/* with the data in front of it as dictionary                           */
+/************************************************************************/
+void ParallelDeflater::CompressBlocks() {
+  for (;;) {
+    std::shared_ptr<Block> block;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      while (!stopping && queuedBlocks.empty()) {
+        blockQueued.wait(guard);
+      }
+      if (stopping) {
+        return;
+      }
+      block = queuedBlocks.front();
+      queuedBlocks.pop_front();
+    }
+
+    try {
+      Deflater deflater(block->level);
+      if (!block->dictionary.empty()) {
+        deflater.SetDictionary(block->dictionary.data(), block->dictionary.size());
+      }
+      std::vector<uint8_t>& output = block->output;
+      output.reserve(block->input.size() / 2);
+      deflater.Deflate(block->input.data(), block->input.size(),
+        block->last ? DEFLATE_FINISH : DEFLATE_SYNC_FLUSH,
+        [&output](const uint8_t* data, size_t length) {
+          output.insert(output.end(), data, data + length);
+        });
+      block->crc = deflater.Crc32();
+    } catch (...) {
+      block->error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      block->done = true;
+    }
+    blockDone.notify_all();
+  }
+}
+
+// queue the collected input as a block, its end becomes the next block's dictionary
+void ParallelDeflater::SubmitBlock(bool last) {
+  std::shared_ptr<Block> block = std::make_shared<Block>();
+  block->level = level;
+  block->last = last;
+  block->dictionary = dictionary;
+  block->input.swap(input);
+  block->crc = 0;
+  block->done = false;
+
+  dictionary.insert(dictionary.end(), block->input.begin(), block->input.end());
+  if (dictionary.size() > PARALLEL_DEFLATE_DICTIONARY_SIZE) {
+    dictionary.erase(dictionary.begin(), dictionary.end() - PARALLEL_DEFLATE_DICTIONARY_SIZE);
+  }
+  input.reserve(PARALLEL_DEFLATE_BLOCK_SIZE);
+
+  pendingBlocks.push_back(block);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queuedBlocks.push_back(block);
+  }
+  blockQueued.notify_one();
+}
+
+void ParallelDeflater::WriteBlocks(bool waitForFirst, const OutputSink& consumeOutput) {
+  while (!pendingBlocks.empty()) {
+    std::shared_ptr<Block> block = pendingBlocks.front();
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (!block->done && !waitForFirst) {
+        return;
+      }
+      while (!block->done) {
+        blockDone.wait(guard);
+      }
+    }
+    waitForFirst = false;
+    pendingBlocks.pop_front();
+    if (block->error) {
+      std::rethrow_exception(block->error);
+    }
+    crc = combineCrc32(crc, block->crc, block->input.size());
+    if (!block->output.empty()) {
+      consumeOutput(block->output.data(), block->output.size());
+      totalOut += block->output.size();
+    }
+  }
+}
+
+void ParallelDeflater::Deflate(const uint8_t* data, size_t length, DeflateFlush flush, const OutputSink& consumeOutput) {
+  if (finished) {
+    throw std::logic_error("The DEFLATE stream is already finished");
+  }
+  totalIn += length;
+  while (length > 0) {
+    size_t copied = std::min(length, PARALLEL_DEFLATE_BLOCK_SIZE - input.size());
+    input.insert(input.end(), data, data + copied);
+    data += copied;
+    length -= copied;
+    if (input.size() == PARALLEL_DEFLATE_BLOCK_SIZE && (length > 0 || flush != DEFLATE_FINISH)) {
+      SubmitBlock(false);
+      WriteBlocks(pendingBlocks.size() >= maxBlocksInFlight, consumeOutput);
+    }
+  }
+
+  if (flush == DEFLATE_SYNC_FLUSH) {
+    if (!input.empty()) {
+      SubmitBlock(false);
+    }
+    while (!pendingBlocks.empty()) {
+      WriteBlocks(true, consumeOutput);
+    }
+  } else if (flush == DEFLATE_FINISH) {
+    SubmitBlock(true);
+    while (!pendingBlocks.empty()) {
+      WriteBlocks(true, consumeOutput);
+    }
+    finished = true;
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "deflate.h"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // input bytes compressed by one worker at a time
+        const size_t PARALLEL_DEFLATE_BLOCK_SIZE = 256 * 1024;
+
+        /************************************************************************/
+        /* Raw DEFLATE compressor that spreads the work over several threads,   */
+        /* the way pigz does. The input is cut into blocks which are compressed */
+        /* independently, each primed with the 32 KB before it as dictionary    */
+        /* and ended with a sync flush, so their output joins into one stream.  */
+        /* The CRC-32 of each block is computed by its worker and combined.     */
+        /* The workers are kept for the lifetime of the object, Reset() starts  */
+        /* a new stream on them.                                                */
+        /************************************************************************/
+        class ParallelDeflater {
+        public:
+          // threadCount 0 starts one worker per core
+          ParallelDeflater(int level, unsigned int threadCount);
+          ~ParallelDeflater();
+
+          // start a new stream, blocks still in progress are dropped
+          void Reset(int level);
+
+          // Same contract as Deflater::Deflate(). Output is handed on in input
+          // order as soon as the blocks are done; the number of blocks in
+          // flight is bounded, so this blocks when the workers fall behind.
+          void Deflate(
+            const uint8_t* input,
+            size_t length,
+            DeflateFlush flush,
+            const OutputSink& consumeOutput
+            );
+
+          uint32_t Crc32() const { return crc; }
+          uint64_t TotalIn() const { return totalIn; }
+          uint64_t TotalOut() const { return totalOut; }
+
+        private:
+          ParallelDeflater(const ParallelDeflater&);
+          ParallelDeflater& operator=(const ParallelDeflater&);
+
+          struct Block {
+            int level;
+            bool last;
+            std::vector<uint8_t> dictionary;
+            std::vector<uint8_t> input;
+            std::vector<uint8_t> output;
+            uint32_t crc;
+            bool done;
+            std::exception_ptr error;
+          };
+
+          void SubmitBlock(bool last);
+          // hand on finished blocks from the front, waiting for the first if asked to
+          void WriteBlocks(bool waitForFirst, const OutputSink& consumeOutput);
+          void CompressBlocks();
+
+          int level;
+          size_t maxBlocksInFlight;
+          std::vector<std::thread> workers;
+
+          // guards everything below that is shared with the workers
+          std::mutex lock;
+          std::condition_variable blockQueued;
+          std::condition_variable blockDone;
+          std::deque<std::shared_ptr<Block>> queuedBlocks;
+          bool stopping;
+
+          // blocks in input order, from submission until they are written
+          std::deque<std::shared_ptr<Block>> pendingBlocks;
+          std::vector<uint8_t> input;
+          std::vector<uint8_t> dictionary;
+          bool finished;
+          uint32_t crc;
+          uint64_t totalIn;
+          uint64_t totalOut;
+        };
+      }
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        /************************************************************************/
+        /* Keeps up to maxIdle objects that are expensive to allocate, so they  */
+        /* can be reused instead of going back to the allocator. Objects are    */
+        /* handed out as unique pointers that return them to the pool when      */
+        /* released. Safe to use from several threads at once. A pool has to    */
+        /* outlive the objects it hands out.                                    */
+        /************************************************************************/
+        template <typename T>
+        class Pool {
+        public:
+          // returns objects to their pool, or deletes them if there is none
+          class Recycle {
+          public:
+            explicit Recycle(Pool* pool = nullptr) : pool(pool) {}
+            void operator()(T* object) const {
+              if (pool != nullptr) {
+                pool->Give(object);
+              } else {
+                delete object;
+              }
+            }
+          private:
+            Pool* pool;
+          };
+          typedef std::unique_ptr<T, Recycle> Pointer;
+
+          explicit Pool(size_t maxIdle) : maxIdle(maxIdle) {
+          }
+
+          ~Pool() {
+            for (size_t i = 0; i < idle.size(); i++) {
+              delete idle[i];
+            }
+          }
+
+          // an idle object as it was given back, null if there is none
+          Pointer Take() {
+            std::lock_guard<std::mutex> guard(lock);
+            if (idle.empty()) {
+              return Pointer(nullptr, Recycle(this));
+            }
+            T* object = idle.back();
+            idle.pop_back();
+            return Pointer(object, Recycle(this));
+          }
+
+          // a new object that joins the pool once it's released
+          Pointer Adopt(T* object) {
+            return Pointer(object, Recycle(this));
+          }
+
+        private:
+          Pool(const Pool&);
+          Pool& operator=(const Pool&);
+
+          void Give(T* object) {
+            {
+              std::lock_guard<std::mutex> guard(lock);
+              if (idle.size() < maxIdle) {
+                idle.push_back(object);
+                return;
+              }
+            }
+            delete object;
+          }
+
+          std::mutex lock;
+          size_t maxIdle;
+          std::vector<T*> idle;
+        };
+      }
+    }
+  }
+}
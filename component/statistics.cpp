@@ -0,0 +1,96 @@
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#include "statistics.h"
+
+using namespace runtime::doo::zip::core;
+
+#ifdef _WIN32
+uint64_t runtime::doo::zip::core::monotonicNanoseconds() {
+  // the frequency is fixed at boot, reading it again is cheap and avoids a
+  // function-local static, which isn't thread safe with older compilers
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  uint64_t ticks = counter.QuadPart;
+  uint64_t perSecond = frequency.QuadPart;
+  // split up so the multiplication can't overflow
+  return ticks / perSecond * 1000000000 + ticks % perSecond * 1000000000 / perSecond;
+}
+#else
+uint64_t runtime::doo::zip::core::monotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#endif
+
+StatisticsCounters::StatisticsCounters() :
+  bytesRead(0),
+  readCount(0),
+  readWaitTime(0),
+  bytesInflated(0),
+  inflateTime(0),
+  bytesWritten(0),
+  writeTime(0),
+  directoryParseTime(0),
+  cacheHits(0),
+  cacheMisses(0) {
+}
+
+ArchiveStatistics::ArchiveStatistics() {
+  Reset();
+}
+
+// nobody waits on the totals, so the order of the updates doesn't matter
+void ArchiveStatistics::Add(const StatisticsCounters& counters) {
+  bytesRead.fetch_add(counters.bytesRead, std::memory_order_relaxed);
+  readCount.fetch_add(counters.readCount, std::memory_order_relaxed);
+  readWaitTime.fetch_add(counters.readWaitTime, std::memory_order_relaxed);
+  bytesInflated.fetch_add(counters.bytesInflated, std::memory_order_relaxed);
+  inflateTime.fetch_add(counters.inflateTime, std::memory_order_relaxed);
+  bytesWritten.fetch_add(counters.bytesWritten, std::memory_order_relaxed);
+  writeTime.fetch_add(counters.writeTime, std::memory_order_relaxed);
+  directoryParseTime.fetch_add(counters.directoryParseTime, std::memory_order_relaxed);
+  cacheHits.fetch_add(counters.cacheHits, std::memory_order_relaxed);
+  cacheMisses.fetch_add(counters.cacheMisses, std::memory_order_relaxed);
+}
+
+void ArchiveStatistics::AddCacheHit() {
+  cacheHits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ArchiveStatistics::AddCacheMiss() {
+  cacheMisses.fetch_add(1, std::memory_order_relaxed);
+}
+
+StatisticsCounters ArchiveStatistics::Snapshot() const {
+  StatisticsCounters totals;
+  totals.bytesRead = bytesRead.load(std::memory_order_relaxed);
+  totals.readCount = readCount.load(std::memory_order_relaxed);
+  totals.readWaitTime = readWaitTime.load(std::memory_order_relaxed);
+  totals.bytesInflated = bytesInflated.load(std::memory_order_relaxed);
+  totals.inflateTime = inflateTime.load(std::memory_order_relaxed);
+  totals.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+  totals.writeTime = writeTime.load(std::memory_order_relaxed);
+  totals.directoryParseTime = directoryParseTime.load(std::memory_order_relaxed);
+  totals.cacheHits = cacheHits.load(std::memory_order_relaxed);
+  totals.cacheMisses = cacheMisses.load(std::memory_order_relaxed);
+  return totals;
+}
+
+void ArchiveStatistics::Reset() {
+  bytesRead.store(0, std::memory_order_relaxed);
+  readCount.store(0, std::memory_order_relaxed);
+  readWaitTime.store(0, std::memory_order_relaxed);
+  bytesInflated.store(0, std::memory_order_relaxed);
+  inflateTime.store(0, std::memory_order_relaxed);
+  bytesWritten.store(0, std::memory_order_relaxed);
+  writeTime.store(0, std::memory_order_relaxed);
+  directoryParseTime.store(0, std::memory_order_relaxed);
+  cacheHits.store(0, std::memory_order_relaxed);
+  cacheMisses.store(0, std::memory_order_relaxed);
+}
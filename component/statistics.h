@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // a monotonic clock for the timings, in nanoseconds from an arbitrary start
+        uint64_t monotonicNanoseconds();
+
+        // What one operation did, or, added up, everything done with an
+        // archive. Times are in nanoseconds.
+        struct StatisticsCounters {
+          StatisticsCounters();
+
+          // requests to the underlying stream, the time spent waiting for
+          // them and the bytes they returned
+          uint64_t bytesRead;
+          uint64_t readCount;
+          uint64_t readWaitTime;
+          // output of the decompressor and the time spent in it
+          uint64_t bytesInflated;
+          uint64_t inflateTime;
+          // data written to extracted files and the time spent writing
+          uint64_t bytesWritten;
+          uint64_t writeTime;
+          // reading and parsing the central directory or a directory index
+          uint64_t directoryParseTime;
+          uint64_t cacheHits;
+          uint64_t cacheMisses;
+        };
+
+        // adds the time between construction and destruction to *total
+        class ScopedTimer {
+        public:
+          explicit ScopedTimer(uint64_t* total) : total(total), start(monotonicNanoseconds()) {
+          }
+
+          ~ScopedTimer() {
+            *total += monotonicNanoseconds() - start;
+          }
+
+        private:
+          ScopedTimer(const ScopedTimer&);
+          ScopedTimer& operator=(const ScopedTimer&);
+
+          uint64_t* total;
+          uint64_t start;
+        };
+
+        /************************************************************************/
+        /* Running totals of the counters of all operations on an archive.      */
+        /* Operations count into their own StatisticsCounters and add them      */
+        /* here once, so the atomics are touched once per operation rather      */
+        /* than per read or per inflated chunk. Safe to use from any thread.    */
+        /************************************************************************/
+        class ArchiveStatistics {
+        public:
+          ArchiveStatistics();
+
+          void Add(const StatisticsCounters& counters);
+          void AddCacheHit();
+          void AddCacheMiss();
+
+          // the current totals, each read on its own while others may still
+          // be adding
+          StatisticsCounters Snapshot() const;
+          void Reset();
+
+        private:
+          ArchiveStatistics(const ArchiveStatistics&);
+          ArchiveStatistics& operator=(const ArchiveStatistics&);
+
+          std::atomic<uint64_t> bytesRead;
+          std::atomic<uint64_t> readCount;
+          std::atomic<uint64_t> readWaitTime;
+          std::atomic<uint64_t> bytesInflated;
+          std::atomic<uint64_t> inflateTime;
+          std::atomic<uint64_t> bytesWritten;
+          std::atomic<uint64_t> writeTime;
+          std::atomic<uint64_t> directoryParseTime;
+          std::atomic<uint64_t> cacheHits;
+          std::atomic<uint64_t> cacheMisses;
+        };
+      }
+    }
+  }
+}
@@ -4,6 +4,12 @@
    Implements RFC 1950: http://www.ietf.org/rfc/rfc1950.txt and RFC 1951: http://www.ietf.org/rfc/rfc1951.txt
 
    The entire decompressor coroutine is implemented in tinfl_decompress(). The other functions are optional high-level helpers.
+
+   Local changes: with a 64-bit bit buffer, Huffman blocks are decoded by tinfl_decode_fast() while enough input and output space
+   remain, using 11-bit multi-symbol literal/length and distance lookup tables, a branchless bit buffer refill and 8/16 byte match
+   copies, which only run past the end of a match into non-wrapping output buffers. The coroutine below handles everything near the
+   buffer edges as before.
+   TINFL_FLAG_STOP_AT_BLOCK_BOUNDARY and tinfl_init_at_block() allow checkpoints at block boundaries to resume decoding from.
 */
 #ifndef TINFL_HEADER_INCLUDED
 #define TINFL_HEADER_INCLUDED
@@ -17,7 +23,7 @@ typedef unsigned int mz_uint32;
 typedef unsigned int mz_uint;
 typedef unsigned long long mz_uint64;
 
-#if defined(_M_IX86) || defined(_M_X64)
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
 // Set MINIZ_USE_UNALIGNED_LOADS_AND_STORES to 1 if integer loads and stores to unaligned addresses are acceptable on the target platform (slightly faster).
 #define MINIZ_USE_UNALIGNED_LOADS_AND_STORES 1
 // Set MINIZ_LITTLE_ENDIAN to 1 if the processor is little endian.
@@ -41,12 +47,14 @@ typedef unsigned long long mz_uint64;
 // TINFL_FLAG_HAS_MORE_INPUT: If set, there are more input bytes available beyond the end of the supplied input buffer. If clear, the input buffer contains all remaining input.
 // TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF: If set, the output buffer is large enough to hold the entire decompressed stream. If clear, the output buffer is at least the size of the dictionary (typically 32KB).
 // TINFL_FLAG_COMPUTE_ADLER32: Force adler-32 checksum computation of the decompressed bytes.
+// TINFL_FLAG_STOP_AT_BLOCK_BOUNDARY: Return TINFL_STATUS_BLOCK_BOUNDARY before each block header is read. The lowest m_num_bits bits of m_bit_buf are input consumed but not yet decoded.
 enum
 {
   TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
   TINFL_FLAG_HAS_MORE_INPUT = 2,
   TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
-  TINFL_FLAG_COMPUTE_ADLER32 = 8
+  TINFL_FLAG_COMPUTE_ADLER32 = 8,
+  TINFL_FLAG_STOP_AT_BLOCK_BOUNDARY = 16
 };
 
 // High level decompression functions:
@@ -82,11 +90,17 @@ typedef enum
   TINFL_STATUS_FAILED = -1,
   TINFL_STATUS_DONE = 0,
   TINFL_STATUS_NEEDS_MORE_INPUT = 1,
-  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+  TINFL_STATUS_BLOCK_BOUNDARY = 3
 } tinfl_status;
 
 // Initializes the decompressor to its initial state.
 #define tinfl_init(r) do { (r)->m_state = 0; } MZ_MACRO_END
+// Initializes the decompressor to continue a raw deflate stream at a block header, with num_bits bits of the header already
+// read into bit_buf. The output buffer must be set up with the 32KB of output preceding the block (wrapping buffer only).
+#define TINFL_BLOCK_BOUNDARY_STATE 55
+#define tinfl_init_at_block(r, bit_buf, num_bits) do { (r)->m_state = TINFL_BLOCK_BOUNDARY_STATE; (r)->m_bit_buf = (bit_buf); (r)->m_num_bits = (num_bits); \
+  (r)->m_dist = (r)->m_counter = (r)->m_num_extra = (r)->m_final = 0; (r)->m_dist_from_out_buf_start = 0; } MZ_MACRO_END
 #define tinfl_get_adler32(r) (r)->m_check_adler32
 
 // Main low-level decompressor coroutine function. This is the only function actually needed for decompression. All the other functions are just high-level helpers for improved usability.
@@ -97,7 +111,8 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
 enum
 {
   TINFL_MAX_HUFF_TABLES = 3, TINFL_MAX_HUFF_SYMBOLS_0 = 288, TINFL_MAX_HUFF_SYMBOLS_1 = 32, TINFL_MAX_HUFF_SYMBOLS_2 = 19,
-  TINFL_FAST_LOOKUP_BITS = 10, TINFL_FAST_LOOKUP_SIZE = 1 << TINFL_FAST_LOOKUP_BITS
+  TINFL_FAST_LOOKUP_BITS = 10, TINFL_FAST_LOOKUP_SIZE = 1 << TINFL_FAST_LOOKUP_BITS,
+  TINFL_FAST_LIT_LEN_BITS = 11, TINFL_FAST_LIT_LEN_SIZE = 1 << TINFL_FAST_LIT_LEN_BITS
 };
 
 typedef struct
@@ -125,6 +140,10 @@ struct tinfl_decompressor_tag
   size_t m_dist_from_out_buf_start;
   tinfl_huff_table m_tables[TINFL_MAX_HUFF_TABLES];
   mz_uint8 m_raw_header[4], m_len_codes[TINFL_MAX_HUFF_SYMBOLS_0 + TINFL_MAX_HUFF_SYMBOLS_1 + 137];
+#if TINFL_USE_64BIT_BITBUF
+  // Lookup tables of the fast path, rebuilt for every Huffman block.
+  mz_uint32 m_fast_lit_len[TINFL_FAST_LIT_LEN_SIZE], m_fast_dist[TINFL_FAST_LOOKUP_SIZE];
+#endif
 };
 
 #endif // #ifdef TINFL_HEADER_INCLUDED
@@ -150,7 +169,8 @@ struct tinfl_decompressor_tag
 #define MZ_MIN(a,b) (((a)<(b))?(a):(b))
 #define MZ_CLEAR_OBJ(obj) memset(&(obj), 0, sizeof(obj))
 
-#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+// Other compilers merge the byte loads below into a single load, without relying on unaligned pointer casts.
+#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN && defined(_MSC_VER)
   #define MZ_READ_LE16(p) *((const mz_uint16 *)(p))
   #define MZ_READ_LE32(p) *((const mz_uint32 *)(p))
 #else
@@ -226,12 +246,201 @@ struct tinfl_decompressor_tag
     code_len = TINFL_FAST_LOOKUP_BITS; do { temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0); \
   } sym = temp; bit_buf >>= code_len; num_bits -= code_len; } MZ_MACRO_END
 
+static const int s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
+static const int s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+static const int s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
+static const int s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+#if TINFL_USE_64BIT_BITBUF
+// Fast path lookup entries. Literal/length entries: bits 0-3 hold the code length, bits 4-5 the kind, bits 8-15 the first literal
+// or the number of extra length bits, bits 16-23 the second literal or bits 16-24 the length base.
+// Distance entries: bits 0-3 code length, bits 4-7 number of extra bits, bits 8-23 distance base.
+enum
+{
+  TINFL_FAST_ONE_LITERAL = 0, TINFL_FAST_TWO_LITERALS = 1, TINFL_FAST_LENGTH = 2, TINFL_FAST_SLOW = 3,
+  TINFL_FAST_DIST_SLOW = 0x80000000U,
+  // the fast path refills with unaligned 8 byte loads and may write up to 16 bytes past the end of a maximum length match
+  TINFL_FAST_INPUT_MARGIN = 8, TINFL_FAST_OUTPUT_MARGIN = 258 + 16
+};
+
+static mz_uint64 tinfl_read_le64(const mz_uint8 *p)
+{
+#if MINIZ_LITTLE_ENDIAN
+  mz_uint64 v; TINFL_MEMCPY(&v, p, sizeof(v)); return v;
+#else
+  return (mz_uint64)MZ_READ_LE32(p) | ((mz_uint64)MZ_READ_LE32(p + 4) << 32);
+#endif
+}
+
+// Decodes the symbol at the bottom of bits if its code is at most avail_bits long. Returns 0 for longer codes and for bit patterns without a code.
+static int tinfl_peek_symbol(const tinfl_huff_table *pTable, mz_uint bits, mz_uint avail_bits, mz_uint *pCode_len, mz_uint *pSym)
+{
+  int temp = pTable->m_look_up[bits & (TINFL_FAST_LOOKUP_SIZE - 1)]; mz_uint code_len;
+  if (temp >= 0)
+    code_len = temp >> 9, temp &= 511;
+  else
+  {
+    code_len = TINFL_FAST_LOOKUP_BITS;
+    while ((temp < 0) && (code_len < avail_bits)) temp = pTable->m_tree[~temp + ((bits >> code_len++) & 1)];
+    if (temp < 0) return 0;
+  }
+  if ((!code_len) || (code_len > avail_bits)) return 0;
+  *pCode_len = code_len; *pSym = temp; return 1;
+}
+
+// Builds the fast path tables from the literal/length and distance tables of the current block. Two literals whose codes fit into
+// TINFL_FAST_LIT_LEN_BITS together share one entry. End of block, invalid symbols and long codes are left to the slow path.
+static void tinfl_build_fast_tables(tinfl_decompressor *r)
+{
+  mz_uint i, code_len, sym, code_len2, sym2;
+  for (i = 0; i < TINFL_FAST_LIT_LEN_SIZE; ++i)
+  {
+    mz_uint32 entry = TINFL_FAST_SLOW << 4;
+    if (tinfl_peek_symbol(&r->m_tables[0], i, TINFL_FAST_LIT_LEN_BITS, &code_len, &sym))
+    {
+      if (sym < 256)
+      {
+        entry = code_len | (TINFL_FAST_ONE_LITERAL << 4) | (sym << 8);
+        if (tinfl_peek_symbol(&r->m_tables[0], i >> code_len, TINFL_FAST_LIT_LEN_BITS - code_len, &code_len2, &sym2) && (sym2 < 256))
+          entry = (code_len + code_len2) | (TINFL_FAST_TWO_LITERALS << 4) | (sym << 8) | (sym2 << 16);
+      }
+      else if ((sym > 256) && (sym < 286))
+        entry = code_len | (TINFL_FAST_LENGTH << 4) | (s_length_extra[sym - 257] << 8) | (s_length_base[sym - 257] << 16);
+    }
+    r->m_fast_lit_len[i] = entry;
+  }
+  for (i = 0; i < TINFL_FAST_LOOKUP_SIZE; ++i)
+  {
+    mz_uint32 entry = TINFL_FAST_DIST_SLOW;
+    if (tinfl_peek_symbol(&r->m_tables[1], i, TINFL_FAST_LOOKUP_BITS, &code_len, &sym) && (sym < 30))
+      entry = code_len | (s_dist_extra[sym] << 4) | (s_dist_base[sym] << 8);
+    r->m_fast_dist[i] = entry;
+  }
+}
+
+// Decodes literals and matches of a Huffman block while at least TINFL_FAST_INPUT_MARGIN input bytes and TINFL_FAST_OUTPUT_MARGIN
+// bytes of output space remain. The bit buffer is refilled once per symbol/match with a single unaligned 64-bit load; bits of a
+// partially consumed byte may be loaded twice, which is harmless because they land at the same position again. Returns when the
+// margins run out or at a symbol it leaves to the slow path (end of block, invalid symbols), without consuming it.
+// Returns 0 if the stream is corrupt.
+static int tinfl_decode_fast(tinfl_decompressor *r, const mz_uint8 **ppIn_buf_cur, const mz_uint8 *pIn_buf_end, mz_uint8 *pOut_buf_start, mz_uint8 **ppOut_buf_cur, mz_uint8 *pOut_buf_end, size_t out_buf_size_mask, tinfl_bit_buf_t *pBit_buf, mz_uint32 *pNum_bits, const mz_uint32 decomp_flags)
+{
+  const mz_uint8 *pIn_buf_cur = *ppIn_buf_cur; mz_uint8 *pOut_buf_cur = *ppOut_buf_cur;
+  tinfl_bit_buf_t bit_buf = *pBit_buf; mz_uint32 num_bits = *pNum_bits; int result = 1;
+  // In a non-wrapping buffer the 8/16 byte match stores may run past the end of a match, into output space that is written next
+  // anyway and that TINFL_FAST_OUTPUT_MARGIN leaves room for. In a wrapping dictionary the bytes ahead still hold the oldest
+  // history, which matches reaching back (almost) 32 KB read, so there every store has to stop at the end of the output.
+  const int exact_stores = !(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  while (((pIn_buf_end - pIn_buf_cur) >= TINFL_FAST_INPUT_MARGIN) && ((pOut_buf_end - pOut_buf_cur) >= TINFL_FAST_OUTPUT_MARGIN))
+  {
+    mz_uint32 entry, kind, code_len, num_extra, counter, dist; size_t dist_from_out_buf_start; mz_uint8 *pSrc, *pOut_match_end;
+
+    // at least 56 bits afterwards, enough for a length and a distance with their extra bits
+    bit_buf |= tinfl_read_le64(pIn_buf_cur) << num_bits; pIn_buf_cur += (63 - num_bits) >> 3; num_bits |= 56;
+
+    entry = r->m_fast_lit_len[bit_buf & (TINFL_FAST_LIT_LEN_SIZE - 1)]; kind = (entry >> 4) & 3; code_len = entry & 15;
+    if (kind <= TINFL_FAST_TWO_LITERALS)
+    {
+      // the second byte is only stored for a pair, see exact_stores
+      pOut_buf_cur[0] = (mz_uint8)(entry >> 8); if (kind) pOut_buf_cur[1] = (mz_uint8)(entry >> 16);
+      pOut_buf_cur += 1 + kind; bit_buf >>= code_len; num_bits -= code_len;
+      // 45 bits are left, another literal entry can be taken without a refill
+      entry = r->m_fast_lit_len[bit_buf & (TINFL_FAST_LIT_LEN_SIZE - 1)]; kind = (entry >> 4) & 3; code_len = entry & 15;
+      if (kind > TINFL_FAST_TWO_LITERALS)
+        continue;
+      pOut_buf_cur[0] = (mz_uint8)(entry >> 8); if (kind) pOut_buf_cur[1] = (mz_uint8)(entry >> 16);
+      pOut_buf_cur += 1 + kind; bit_buf >>= code_len; num_bits -= code_len;
+      continue;
+    }
+    if (kind == TINFL_FAST_LENGTH)
+    {
+      num_extra = (entry >> 8) & 15; counter = entry >> 16;
+    }
+    else
+    {
+      int temp = r->m_tables[0].m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)];
+      if (temp >= 0)
+        code_len = temp >> 9, temp &= 511;
+      else
+      {
+        code_len = TINFL_FAST_LOOKUP_BITS; do { temp = r->m_tables[0].m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0);
+      }
+      if ((!code_len) || (temp == 256) || (temp >= 286))
+        break;
+      if (temp < 256)
+      {
+        *pOut_buf_cur++ = (mz_uint8)temp; bit_buf >>= code_len; num_bits -= code_len;
+        continue;
+      }
+      num_extra = s_length_extra[temp - 257]; counter = s_length_base[temp - 257];
+    }
+    bit_buf >>= code_len; num_bits -= code_len;
+    counter += (mz_uint32)(bit_buf & ((1U << num_extra) - 1)); bit_buf >>= num_extra; num_bits -= num_extra;
+
+    entry = r->m_fast_dist[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)];
+    if (entry & TINFL_FAST_DIST_SLOW)
+    {
+      int temp = r->m_tables[1].m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)];
+      if (temp >= 0)
+        code_len = temp >> 9, temp &= 511;
+      else
+      {
+        code_len = TINFL_FAST_LOOKUP_BITS; do { temp = r->m_tables[1].m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0);
+      }
+      if (temp >= 30)
+      {
+        result = 0; break;
+      }
+      num_extra = s_dist_extra[temp]; dist = s_dist_base[temp];
+    }
+    else
+    {
+      code_len = entry & 15; num_extra = (entry >> 4) & 15; dist = entry >> 8;
+    }
+    bit_buf >>= code_len; num_bits -= code_len;
+    dist += (mz_uint32)(bit_buf & ((1U << num_extra) - 1)); bit_buf >>= num_extra; num_bits -= num_extra;
+
+    dist_from_out_buf_start = pOut_buf_cur - pOut_buf_start;
+    if (dist > dist_from_out_buf_start)
+    {
+      if (decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)
+      {
+        result = 0; break;
+      }
+      // the match starts before the wrap around of the dictionary
+      while (counter--) *pOut_buf_cur++ = pOut_buf_start[(dist_from_out_buf_start++ - dist) & out_buf_size_mask];
+      continue;
+    }
+
+    pSrc = pOut_buf_cur - dist; pOut_match_end = pOut_buf_cur + counter;
+    if (dist == 1)
+    {
+      TINFL_MEMSET(pOut_buf_cur, pSrc[0], counter);
+      pOut_buf_cur = pOut_match_end;
+      continue;
+    }
+    // with exact_stores only whole stores that end within the match, the rest byte by byte
+    if (dist >= 16)
+    {
+      while ((pOut_match_end - pOut_buf_cur) >= (exact_stores ? 16 : 1)) { TINFL_MEMCPY(pOut_buf_cur, pSrc, 16); pOut_buf_cur += 16; pSrc += 16; }
+    }
+    else if (dist >= 8)
+    {
+      while ((pOut_match_end - pOut_buf_cur) >= (exact_stores ? 8 : 1)) { TINFL_MEMCPY(pOut_buf_cur, pSrc, 8); pOut_buf_cur += 8; pSrc += 8; }
+    }
+    while (pOut_buf_cur < pOut_match_end) *pOut_buf_cur++ = *pSrc++;
+    pOut_buf_cur = pOut_match_end;
+  }
+
+  // the slow path expects the bits above num_bits to be clear
+  bit_buf &= (((tinfl_bit_buf_t)1) << num_bits) - 1;
+  *ppIn_buf_cur = pIn_buf_cur; *ppOut_buf_cur = pOut_buf_cur; *pBit_buf = bit_buf; *pNum_bits = num_bits;
+  return result;
+}
+#endif
+
 tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
 {
-  static const int s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
-  static const int s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
-  static const int s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
-  static const int s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
   static const mz_uint8 s_length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
   static const int s_min_table_sizes[3] = { 257, 1, 4 };
 
@@ -257,6 +466,7 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
 
   do
   {
+    if (decomp_flags & TINFL_FLAG_STOP_AT_BLOCK_BOUNDARY) { TINFL_CR_RETURN(TINFL_BLOCK_BOUNDARY_STATE, TINFL_STATUS_BLOCK_BOUNDARY); }
     TINFL_GET_BITS(3, r->m_final, 3); r->m_type = r->m_final >> 1;
     if (r->m_type == 0)
     {
@@ -350,9 +560,18 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
           TINFL_MEMCPY(r->m_tables[0].m_code_size, r->m_len_codes, r->m_table_sizes[0]); TINFL_MEMCPY(r->m_tables[1].m_code_size, r->m_len_codes + r->m_table_sizes[0], r->m_table_sizes[1]);
         }
       }
+#if TINFL_USE_64BIT_BITBUF
+      tinfl_build_fast_tables(r);
+#endif
       for ( ; ; )
       {
         mz_uint8 *pSrc;
+#if TINFL_USE_64BIT_BITBUF
+        if (!tinfl_decode_fast(r, &pIn_buf_cur, pIn_buf_end, pOut_buf_start, &pOut_buf_cur, pOut_buf_end, out_buf_size_mask, &bit_buf, &num_bits, decomp_flags))
+        {
+          TINFL_CR_RETURN_FOREVER(54, TINFL_STATUS_FAILED);
+        }
+#endif
         for ( ; ; )
         {
           if (((pIn_buf_end - pIn_buf_cur) < 4) || ((pOut_buf_end - pOut_buf_cur) < 2))
@@ -435,8 +654,7 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
           const mz_uint8 *pSrc_end = pSrc + (counter & ~7);
           do
           {
-            ((mz_uint32 *)pOut_buf_cur)[0] = ((const mz_uint32 *)pSrc)[0];
-            ((mz_uint32 *)pOut_buf_cur)[1] = ((const mz_uint32 *)pSrc)[1];
+            TINFL_MEMCPY(pOut_buf_cur, pSrc, 8);
             pOut_buf_cur += 8;
           } while ((pSrc += 8) < pSrc_end);
           if ((counter &= 7) < 3)
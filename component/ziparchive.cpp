@@ -6,8 +6,19 @@
 #include <ppl.h>
 #include <ppltasks.h>
 
-#include "tinfl.c"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
+#include "crc32.h"
+#include "directoryindex.h"
+#include "inflate.h"
+#include "inflateindex.h"
+#include "statistics.h"
 #include "ziparchive.h"
 
 using namespace runtime::doo::zip;
@@ -19,6 +30,7 @@ using Microsoft::WRL::ComPtr;
 
 using Windows::Foundation::IAsyncOperation;
 using Windows::Foundation::IAsyncAction;
+using Windows::Foundation::Collections::IVectorView;
 using Windows::Storage::Streams::IBuffer;
 using Windows::Storage::Streams::IBufferByteAccess;
 using Windows::Storage::Streams::IInputStream;
@@ -28,11 +40,6 @@ using Windows::Storage::IStorageFolder;
 
 using concurrency::cancellation_token;
 
-// the expected signatures for different parts of a ZIP file
-#define ZipArchive_ENTRY_LOCAL_HEADER_SIGNATURE 0x04034b50
-#define ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE 0x02014b50
-#define ZipArchive_END_OF_CENTRAL_RECORD_SIGNATURE 0x06054b50
-
 static ComPtr<IBufferByteAccess> getByteAccessForBuffer(IBuffer^ buffer) {
   ComPtr<IUnknown> comBuffer(reinterpret_cast<IUnknown*>(buffer));
   ComPtr<IBufferByteAccess> byteBuffer;
@@ -40,96 +47,609 @@ static ComPtr<IBufferByteAccess> getByteAccessForBuffer(IBuffer^ buffer) {
   return byteBuffer;
 }
 
+static byte* getBufferData(IBuffer^ buffer) {
+  byte* data;
+  getByteAccessForBuffer(buffer)->Buffer(&data);
+  return data;
+}
+
+/************************************************************************/
+/* Read length bytes from the stream straight into destination. Streams */
+/* usually fill the buffer they are handed; if one returns a buffer of  */
+/* its own or reads short, the remaining data is copied in.             */
+/************************************************************************/
+static void readStreamIntoBuffer(IInputStream^ stream, IBuffer^ destination, uint32 length,
+                                 core::StatisticsCounters* counters) {
+  core::ScopedTimer wait(&counters->readWaitTime);
+  byte* target = getBufferData(destination);
+  concurrency::task<IBuffer^> readTask(
+    stream->ReadAsync(destination, length, Windows::Storage::Streams::InputStreamOptions::None));
+  IBuffer^ read = readTask.get();
+  counters->readCount++;
+  uint32 received = read->Length;
+  if (read != destination && received > 0) {
+    memcpy(target, getBufferData(read), received);
+  }
+  while (received < length) {
+    auto rest = ref new Windows::Storage::Streams::Buffer(length - received);
+    concurrency::task<IBuffer^> readRestTask(
+      stream->ReadAsync(rest, length - received, Windows::Storage::Streams::InputStreamOptions::None));
+    read = readRestTask.get();
+    counters->readCount++;
+    if (read->Length == 0) {
+      throw ref new Platform::FailureException(L"Unexpected end of ZIP file");
+    }
+    memcpy(target + received, getBufferData(read), read->Length);
+    received += read->Length;
+  }
+  counters->bytesRead += length;
+  destination->Length = length;
+}
+
 // Helper method to comfortably read data from an IDataReader into a memory location
 static void readBytesFromDataReader(Windows::Storage::Streams::IDataReader^ dataReader, 
-                             uint32 length, void* destination, size_t destSize) {
+                             uint32 length, void* destination, size_t destSize,
+                             core::StatisticsCounters* counters) {
+  if (length > destSize) {
+    throw ref new Platform::InvalidArgumentException(L"Destination buffer too small");
+  }
   uint32 read = 0;
-  while (read < length) {
-    concurrency::task<uint32> readDataTask(dataReader->LoadAsync(length-read));
-    read += readDataTask.get();
+  {
+    core::ScopedTimer wait(&counters->readWaitTime);
+    while (read < length) {
+      concurrency::task<uint32> readDataTask(dataReader->LoadAsync(length-read));
+      uint32 readNow = readDataTask.get();
+      counters->readCount++;
+      if (readNow == 0) {
+        throw ref new Platform::FailureException(L"Unexpected end of ZIP file");
+      }
+      read += readNow;
+    }
+  }
+  counters->bytesRead += read;
+  if (length > 0) {
+    dataReader->ReadBytes(
+      Platform::ArrayReference<byte>(reinterpret_cast<byte*>(destination), length));
   }
-  auto buffer = dataReader->ReadBuffer(length);
-  auto byteBuffer = getByteAccessForBuffer(buffer);
-  byte* data;
-  byteBuffer->Buffer(&data);
-  memcpy_s(destination, destSize, data, length);
 }
 
-static String^ charToPlatformString(const char* strData) {
-  std::string stdString(strData);
-  std::wstring stdWString;
-  stdWString.assign(stdString.begin(), stdString.end());
-  String^ result = ref new String(stdWString.c_str());
-  return result;
+// read length bytes starting at offset with a single request to the stream
+static void readBytesFromStream(IRandomAccessStream^ stream, 
+                                DWORD64 offset, uint32 length, void* destination, size_t destSize,
+                                core::StatisticsCounters* counters) {
+  auto dataReader = ref new Windows::Storage::Streams::DataReader(stream->GetInputStreamAt(offset));
+  readBytesFromDataReader(dataReader, length, destination, destSize, counters);
+  dataReader->DetachStream();
 }
 
-// interpret the next length bytes from the stream as a string
-// since strings in ZIP files aren't null-terminated, add trailing null
-static String^ readString(IInputStream^ stream, uint16 length) {
-  char* buffer = new char[length+1];
-  auto dataReader = ref new Windows::Storage::Streams::DataReader(stream);
-  readBytesFromDataReader(dataReader, length, buffer, length+1);
-  dataReader->DetachStream();
-  buffer[length] = 0x0;
-  String^ result = charToPlatformString(buffer);
-  delete[] buffer;
-  return result;
+// Strings in ZIP files aren't null-terminated, so they're converted with an explicit length.
+// Every byte becomes the character with the same value, as unsigned so 0x80-0xFF stay below 0x100.
+static String^ bytesToPlatformString(const char* data, size_t length) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  std::wstring stdWString(bytes, bytes + length);
+  return ref new String(stdWString.c_str(), static_cast<unsigned int>(stdWString.length()));
+}
+
+// the reverse of bytesToPlatformString, false if a character doesn't fit in a byte
+static bool platformStringToBytes(String^ text, std::string* bytes) {
+  bytes->resize(text->Length());
+  for (unsigned int i = 0; i < text->Length(); i++) {
+    if (text->Data()[i] > 0xFF) {
+      return false;
+    }
+    (*bytes)[i] = static_cast<char>(text->Data()[i]);
+  }
+  return true;
+}
+
+// Filenames of entries that set the UTF-8 flag are decoded as UTF-8, the
+// others byte by byte like bytesToPlatformString.
+static std::wstring decodeFilename(const char* data, size_t length, bool utf8) {
+  if (!utf8) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    return std::wstring(bytes, bytes + length);
+  }
+  std::wstring decoded;
+  int decodedLength = MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(length), nullptr, 0);
+  if (decodedLength > 0) {
+    decoded.resize(decodedLength);
+    MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(length), &decoded[0], decodedLength);
+  }
+  return decoded;
+}
+
+// which entries a name encoded by encodeForLookup applies to
+enum LookupEncoding {
+  LOOKUP_ANY_ENTRY,
+  LOOKUP_UTF8_ENTRIES,
+  LOOKUP_BYTE_ENTRIES
+};
+
+/************************************************************************/
+/* The entry table keeps filenames as stored, UTF-8 for entries that    */
+/* flag it and a byte per character for the others. Text to look up is  */
+/* encoded both ways, and an entry only counts if it is stored the way  */
+/* it was found. Returns the number of encodings, ASCII text is the     */
+/* same in both and applies to any entry.                               */
+/************************************************************************/
+static int encodeForLookup(String^ text, std::string encoded[2], LookupEncoding encodings[2]) {
+  const wchar_t* characters = text != nullptr ? text->Data() : L"";
+  int length = text != nullptr ? static_cast<int>(text->Length()) : 0;
+  int utf8Length = WideCharToMultiByte(CP_UTF8, 0, characters, length, nullptr, 0, nullptr, nullptr);
+  encoded[0].assign(utf8Length, '\0');
+  if (utf8Length > 0) {
+    WideCharToMultiByte(CP_UTF8, 0, characters, length, &encoded[0][0], utf8Length, nullptr, nullptr);
+  }
+  if (utf8Length == length) {
+    encodings[0] = LOOKUP_ANY_ENTRY;
+    return 1;
+  }
+  encodings[0] = LOOKUP_UTF8_ENTRIES;
+  // the table holds the other filenames as bytes, text with wider characters isn't among them
+  if (!platformStringToBytes(text, &encoded[1])) {
+    return 1;
+  }
+  encodings[1] = LOOKUP_BYTE_ENTRIES;
+  return 2;
+}
+
+static bool isStoredAs(const core::EntryTable& table, size_t index, LookupEncoding encoding) {
+  return encoding == LOOKUP_ANY_ENTRY || table.Utf8Filename(index) == (encoding == LOOKUP_UTF8_ENTRIES);
+}
+
+// append the entries a query found that are stored in the encoding it ran with
+static void appendStoredAs(const core::EntryTable& table, const std::vector<size_t>& found, 
+                           LookupEncoding encoding, std::vector<size_t>* entries) {
+  for (size_t i = 0; i < found.size(); i++) {
+    if (isStoredAs(table, found[i], encoding)) {
+      entries->push_back(found[i]);
+    }
+  }
+}
+
+/************************************************************************/
+/* Check a local header read into memory against the filename from the  */
+/* central directory. Returns the length of the header with filename    */
+/* and extra field, the file data follows right after it.               */
+/************************************************************************/
+static uint32 checkLocalHeader(const byte* data, size_t length, 
+                               const char* filename, uint16 filenameLength) {
+  core::LocalFileHeader localHeader;
+  if (length < sizeof(core::LocalFileHeader) + filenameLength ||
+      !core::readLocalHeader(data, length, &localHeader)) {
+    throw ref new Platform::FailureException(
+      L"Invalid local header: " + bytesToPlatformString(filename, filenameLength));
+  }
+  const char* localFilename = reinterpret_cast<const char*>(data + sizeof(core::LocalFileHeader));
+  if (localHeader.filenameLength != filenameLength ||
+      memcmp(localFilename, filename, filenameLength) != 0) {
+    throw ref new Platform::FailureException(
+      L"Filename in local header does not match: " + bytesToPlatformString(filename, filenameLength) + 
+      L" : " + bytesToPlatformString(localFilename, min(localHeader.filenameLength, filenameLength)));
+  }
+  return sizeof(core::LocalFileHeader) + localHeader.filenameLength + localHeader.extraFieldLength;
+}
+
+// header and filename are fetched from the stream in a single read
+static uint32 readAndCheckLocalHeader(IRandomAccessStream^ stream, DWORD64 offset,
+                                      const char* filename, uint16 filenameLength,
+                                      core::StatisticsCounters* counters) {
+  uint32 length = sizeof(core::LocalFileHeader) + filenameLength;
+  std::unique_ptr<byte[]> data(new byte[length]);
+  readBytesFromStream(stream, offset, length, data.get(), length, counters);
+  return checkLocalHeader(data.get(), length, filename, filenameLength);
 }
 
 /************************************************************************/
-/* Instantiate a ZipArchiveEntry from a stream positioned at the central   */
-/* directory record for a file. Will leave the stream positioned at     */
-/* the beginning of the next record.                                    */
+/* The statistics of an archive, shared with its entries: the totals of */
+/* all operations, and the handler that entry operations are traced to. */
 /************************************************************************/
-ZipArchiveEntry::ZipArchiveEntry(IRandomAccessStream^ stream) {
-  auto dataReader = ref new Windows::Storage::Streams::DataReader(stream);
-  
-  memset(&centralDirectoryRecord, 0, sizeof(centralDirectoryRecord));
-  memset(&localHeader, 0, sizeof(localHeader));
+class runtime::doo::zip::StatisticsCollector {
+public:
+  StatisticsCollector() : traceHandler(nullptr) {
+  }
 
-  readBytesFromDataReader(
-    dataReader, 
-    sizeof(ZipArchiveEntry::CentralDirectoryRecord), 
-    &centralDirectoryRecord, 
-    sizeof(centralDirectoryRecord));
-  // make sure the stream stays usable for the next record
-  dataReader->DetachStream();
+  core::ArchiveStatistics& Totals() {
+    return totals;
+  }
+
+  ZipArchiveEntryTraceHandler^ TraceHandler() {
+    concurrency::critical_section::scoped_lock lock(handlerLock);
+    return traceHandler;
+  }
+
+  void SetTraceHandler(ZipArchiveEntryTraceHandler^ handler) {
+    concurrency::critical_section::scoped_lock lock(handlerLock);
+    traceHandler = handler;
+  }
+
+  // add an operation to the totals and trace it if it was about an entry
+  void Record(String^ filename, ZipArchiveEntryOperation operation, 
+              uint64 duration, const core::StatisticsCounters& counters) {
+    totals.Add(counters);
+    if (filename == nullptr) {
+      return;
+    }
+    ZipArchiveEntryTraceHandler^ handler = TraceHandler();
+    if (handler != nullptr) {
+      try {
+        handler(ref new ZipArchiveEntryTrace(filename, operation, duration, counters));
+      } catch (...) {
+      }
+    }
+  }
+
+private:
+  core::ArchiveStatistics totals;
+  concurrency::critical_section handlerLock;
+  ZipArchiveEntryTraceHandler^ traceHandler;
+};
+
+// Counts what one operation does, and records it when it goes out of
+// scope, whether the operation succeeded or not
+class RecordedOperation {
+public:
+  // work that isn't about a single entry, only added to the totals
+  explicit RecordedOperation(const std::shared_ptr<StatisticsCollector>& statistics) :
+    statistics(statistics),
+    filename(nullptr),
+    operation(ZipArchiveEntryOperation::ReadContents),
+    start(core::monotonicNanoseconds()) {
+  }
+
+  RecordedOperation(const std::shared_ptr<StatisticsCollector>& statistics,
+                    String^ filename,
+                    ZipArchiveEntryOperation operation) :
+    statistics(statistics),
+    filename(filename),
+    operation(operation),
+    start(core::monotonicNanoseconds()) {
+  }
 
-  if (centralDirectoryRecord.signature != ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE) {
-    throw ref new Platform::FailureException(L"Invalid ZIP file entry header");
+  ~RecordedOperation() {
+    statistics->Record(filename, operation, core::monotonicNanoseconds() - start, counters);
   }
 
-  filename = readString(stream, centralDirectoryRecord.filenameLength);
+  core::StatisticsCounters counters;
 
-  IInputStream^ localHeaderInputStream = 
-    stream->GetInputStreamAt(centralDirectoryRecord.localHeaderOffset);
-  ReadAndCheckLocalHeader(localHeaderInputStream);
-  
-  contentStreamStart = centralDirectoryRecord.localHeaderOffset +
-    + sizeof(LocalFileHeader) 
-    + localHeader.filenameLength 
-    + localHeader.extraFieldLength;
+private:
+  RecordedOperation(const RecordedOperation&);
+  RecordedOperation& operator=(const RecordedOperation&);
 
-  // make sure the stream is ready to read the next header
-  if (centralDirectoryRecord.extraFieldLength > 0) {
-    stream->Seek(stream->Position + centralDirectoryRecord.extraFieldLength);
+  std::shared_ptr<StatisticsCollector> statistics;
+  String^ filename;
+  ZipArchiveEntryOperation operation;
+  uint64 start;
+};
+
+// write to an extracted file, counting the bytes and the time it takes
+static void writeToFile(FILE* out, const byte* data, size_t length, 
+                        String^ filename, core::StatisticsCounters* counters) {
+  core::ScopedTimer writing(&counters->writeTime);
+  if (fwrite(data, 1, length, out) != length) {
+    throw ref new Platform::FailureException(L"Could not write data for file " + filename);
+  }
+  counters->bytesWritten += length;
+}
+
+// size of the compressed chunks pulled from the archive while inflating
+#define INFLATE_CHUNK_SIZE 256*1024
+// idle chunks of INFLATE_CHUNK_SIZE kept for the next reader
+#define CHUNK_POOL_SIZE 8
+
+typedef core::Pool<std::vector<byte>>::Pointer ChunkPointer;
+static core::Pool<std::vector<byte>> chunkPool(CHUNK_POOL_SIZE);
+
+// chunks of the default size come from the pool, other sizes are rare
+static ChunkPointer allocateChunk(uint32 size) {
+  if (size == INFLATE_CHUNK_SIZE) {
+    ChunkPointer chunk = chunkPool.Take();
+    if (chunk) {
+      return chunk;
+    }
+    return chunkPool.Adopt(new std::vector<byte>(size));
   }
+  return ChunkPointer(new std::vector<byte>(size));
 }
 
 /************************************************************************/
-/* Read the local header and check it against the central directory     */
+/* Reads a fixed number of bytes from a stream in chunks of at most     */
+/* chunkSize. The next chunk is requested from the stream as soon as    */
+/* the current one has been handed out, so the caller can work on one   */
+/* chunk while the next one is being loaded. Reads are counted in       */
+/* counters, which has to outlive the reader.                           */
 /************************************************************************/
-void ZipArchiveEntry::ReadAndCheckLocalHeader(IInputStream^ stream) {
-  auto dataReader = ref new Windows::Storage::Streams::DataReader(stream);
-  readBytesFromDataReader(dataReader, sizeof(LocalFileHeader), &localHeader, sizeof(localHeader));
-  if (localHeader.signature != ZipArchive_ENTRY_LOCAL_HEADER_SIGNATURE) {
-    throw ref new Platform::FailureException(L"Invalid local header: " + filename);
+class ChunkedStreamReader {
+public:
+  ChunkedStreamReader(IInputStream^ stream, uint64 length, core::StatisticsCounters* counters,
+                      uint32 chunkSize = INFLATE_CHUNK_SIZE) : 
+    dataReader(ref new Windows::Storage::Streams::DataReader(stream)),
+    chunk(allocateChunk(chunkSize)),
+    chunkSize(chunkSize),
+    remaining(length),
+    pendingLength(0),
+    counters(counters) {
+    RequestNextChunk();
   }
-  String^ localFilename = readString(stream, localHeader.filenameLength);
-  if (wcscmp(localFilename->Data(), filename->Data()) != 0) {
-    throw ref new Platform::FailureException(
-      L"Filename in local header does not match: " + filename + L" : " + localFilename);
+
+  ~ChunkedStreamReader() {
+    // don't leave a load running against a reader that's going away
+    if (pendingLength > 0) {
+      try { pendingLoad.wait(); } catch (...) {}
+    }
+    dataReader->DetachStream();
+  }
+
+  bool HasMoreData() const {
+    return pendingLength > 0;
+  }
+
+  // waits for the chunk requested last, returns it and requests the next one
+  // the returned pointer stays valid until the next call
+  const byte* NextChunk(uint32* chunkLength) {
+    {
+      core::ScopedTimer wait(&counters->readWaitTime);
+      uint32 loaded = pendingLoad.get();
+      counters->readCount++;
+      while (loaded < pendingLength) {
+        concurrency::task<uint32> loadDataTask(dataReader->LoadAsync(pendingLength - loaded));
+        uint32 loadedNow = loadDataTask.get();
+        counters->readCount++;
+        if (loadedNow == 0) {
+          throw ref new Platform::FailureException(L"Unexpected end of ZIP file");
+        }
+        loaded += loadedNow;
+      }
+    }
+    counters->bytesRead += pendingLength;
+    dataReader->ReadBytes(Platform::ArrayReference<byte>(chunk->data(), pendingLength));
+    *chunkLength = pendingLength;
+    RequestNextChunk();
+    return chunk->data();
+  }
+
+private:
+  void RequestNextChunk() {
+    pendingLength = static_cast<uint32>(min((uint64)chunkSize, remaining));
+    remaining -= pendingLength;
+    if (pendingLength > 0) {
+      pendingLoad = concurrency::task<uint32>(dataReader->LoadAsync(pendingLength));
+    }
+  }
+
+  Windows::Storage::Streams::DataReader^ dataReader;
+  ChunkPointer chunk;
+  uint32 chunkSize;
+  uint64 remaining;
+  uint32 pendingLength;
+  concurrency::task<uint32> pendingLoad;
+  core::StatisticsCounters* counters;
+};
+
+/************************************************************************/
+/* Forward-only stream of an entry's uncompressed contents. Compressed  */
+/* data is pulled from the archive in chunks of readaheadSize, each     */
+/* requested while the one before is inflated, and inflated only as far */
+/* as reads ask for. The CRC-32 is checked once the end is reached. The  */
+/* stream is traced as a single operation when it's closed.             */
+/************************************************************************/
+ref class runtime::doo::zip::ZipEntryInputStream sealed : public IInputStream {
+internal:
+  ZipEntryInputStream(ZipArchiveEntry^ entry, IInputStream^ stream, uint32 readaheadSize) :
+    entry(entry),
+    operation(new RecordedOperation(entry->statistics, entry->filename, ZipArchiveEntryOperation::ReadStream)),
+    reader(new ChunkedStreamReader(stream, entry->compressedSize, &operation->counters, readaheadSize)),
+    input(nullptr),
+    inputAvailable(0),
+    pending(nullptr),
+    pendingSize(0),
+    crc(0),
+    finished(false) {
+    if (entry->centralDirectoryRecord.compressionMethod == 8) {
+      inflater = core::acquireInflater();
+    }
+  }
+
+public:
+  virtual ~ZipEntryInputStream() {
+    concurrency::critical_section::scoped_lock lock(readLock);
+    reader.reset();
+    operation.reset();
+  }
+
+  virtual Windows::Foundation::IAsyncOperationWithProgress<IBuffer^, uint32>^ ReadAsync(
+    IBuffer^ buffer, 
+    uint32 count, 
+    Windows::Storage::Streams::InputStreamOptions options) {
+    if (buffer == nullptr || buffer->Capacity < count) {
+      throw ref new Platform::InvalidArgumentException(L"Buffer too small");
+    }
+    return concurrency::create_async(
+      [=](concurrency::progress_reporter<uint32>, cancellation_token cancellationToken) -> IBuffer^ {
+      concurrency::critical_section::scoped_lock lock(readLock);
+      if (!reader) {
+        throw ref new Platform::ObjectDisposedException();
+      }
+      bool partial = (options & Windows::Storage::Streams::InputStreamOptions::Partial) != 
+        Windows::Storage::Streams::InputStreamOptions::None;
+      byte* target = getBufferData(buffer);
+      uint32 filled = 0;
+      while (filled < count) {
+        if (pendingSize == 0) {
+          // partial reads return what they have rather than wait for the archive
+          if (finished || !ProduceOutput(partial && filled > 0, cancellationToken)) {
+            break;
+          }
+          continue;
+        }
+        uint32 copied = static_cast<uint32>(min((size_t)(count - filled), pendingSize));
+        memcpy(target + filled, pending, copied);
+        pending += copied;
+        pendingSize -= copied;
+        filled += copied;
+      }
+      buffer->Length = filled;
+      return buffer;
+    });
+  }
+
+private:
+  // Make the next piece of output pending. Returns false without doing
+  // anything if that needs the next chunk and dontWait is set.
+  bool ProduceOutput(bool dontWait, const cancellation_token& cancellationToken) {
+    if (cancellationToken.is_canceled()) {
+      concurrency::cancel_current_task();
+    }
+    if (inputAvailable == 0 && reader->HasMoreData()) {
+      if (dontWait) {
+        return false;
+      }
+      input = reader->NextChunk(&inputAvailable);
+    }
+
+    if (!inflater) { // stored, hand out the chunk as it is
+      if (inputAvailable == 0) {
+        finished = true;
+        entry->CheckCrc32(crc);
+        return true;
+      }
+      crc = core::updateCrc32(crc, input, inputAvailable);
+      pending = input;
+      pendingSize = inputAvailable;
+      input += inputAvailable;
+      inputAvailable = 0;
+      return true;
+    }
+
+    size_t inputSize = inputAvailable;
+    tinfl_status status;
+    {
+      core::ScopedTimer inflating(&operation->counters.inflateTime);
+      status = inflater->Inflate(input, &inputSize, reader->HasMoreData(), &pending, &pendingSize);
+    }
+    operation->counters.bytesInflated += pendingSize;
+    input += inputSize;
+    inputAvailable -= static_cast<uint32>(inputSize);
+    if (status == TINFL_STATUS_DONE && inflater->TotalOut() == entry->uncompressedSize) {
+      finished = true;
+      entry->CheckCrc32(inflater->Crc32());
+    } else if (status == TINFL_STATUS_DONE ||
+               status < TINFL_STATUS_DONE ||
+               (status == TINFL_STATUS_NEEDS_MORE_INPUT && !reader->HasMoreData()) ||
+               inflater->TotalOut() > entry->uncompressedSize) {
+      throw ref new Platform::FailureException(L"Could not extract data for file " + entry->filename);
+    }
+    return true;
+  }
+
+  ZipArchiveEntry^ entry;
+  concurrency::critical_section readLock;
+  std::unique_ptr<RecordedOperation> operation;
+  std::unique_ptr<ChunkedStreamReader> reader;
+  core::PooledInflater inflater;
+  const byte* input;
+  uint32 inputAvailable;
+  // output not handed out yet, stays valid until the next chunk or Inflate() call
+  const byte* pending;
+  size_t pendingSize;
+  uint32 crc;
+  bool finished;
+};
+
+// Lower case version of a filename, used as key for case insensitive lookups.
+// As UTF-8, so the folded names sort and match like the filenames do.
+static std::string foldFilenameCase(const wchar_t* filename, size_t length) {
+  std::wstring folded(filename, length);
+  if (folded.empty()) {
+    return std::string();
+  }
+  LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_LOWERCASE, 
+    filename, static_cast<int>(length), 
+    &folded[0], static_cast<int>(folded.length()), 
+    nullptr, nullptr, 0);
+  int utf8Length = WideCharToMultiByte(CP_UTF8, 0, folded.data(), static_cast<int>(folded.length()), 
+    nullptr, 0, nullptr, nullptr);
+  std::string utf8Folded(utf8Length, '\0');
+  if (utf8Length > 0) {
+    WideCharToMultiByte(CP_UTF8, 0, folded.data(), static_cast<int>(folded.length()), 
+      &utf8Folded[0], utf8Length, nullptr, nullptr);
+  }
+  return utf8Folded;
+}
+
+/************************************************************************/
+/* Instantiate a ZipArchiveEntry from its central directory entry. The  */
+/* local header is checked on first access unless it has been already,  */
+/* which contentStreamStart tells.                                      */
+/************************************************************************/
+ZipArchiveEntry::ZipArchiveEntry(const core::EntryInfo& entry,
+                                 DWORD64 contentStreamStart,
+                                 const std::shared_ptr<StatisticsCollector>& statistics) :
+  statistics(statistics),
+  centralDirectoryRecord(entry.record),
+  rawFilename(entry.filename, entry.filenameLength),
+  compressedSize(entry.compressedSize),
+  uncompressedSize(entry.uncompressedSize),
+  localHeaderOffset(entry.localHeaderOffset),
+  localHeaderChecked(contentStreamStart != 0),
+  contentStreamStart(contentStreamStart),
+  checkpointIndexComplete(false),
+  checkpointSpacing(0) {
+  std::wstring decodedFilename = decodeFilename(
+    entry.filename, entry.filenameLength, (entry.record.flags & ZipArchive_FLAG_UTF8) != 0);
+  filename = ref new String(decodedFilename.c_str(), static_cast<unsigned int>(decodedFilename.length()));
+}
+
+/************************************************************************/
+/* Compare the CRC-32 of the data that was read against the one stored  */
+/* in the central directory                                             */
+/************************************************************************/
+void ZipArchiveEntry::CheckCrc32(uint32 crc) {
+  if (crc != centralDirectoryRecord.crc32) {
+    throw ref new Platform::FailureException(L"CRC-32 mismatch, file is corrupt: " + filename);
+  }
+}
+
+/************************************************************************/
+/* Return where the file data starts in the archive. This is only known */
+/* once the local header has been read, which happens on first access   */
+/* for archives opened with CentralDirectoryOnly.                       */
+/************************************************************************/
+DWORD64 ZipArchiveEntry::ResolveContentStreamStart(IRandomAccessStream^ stream,
+                                                   core::StatisticsCounters* counters) {
+  concurrency::critical_section::scoped_lock lock(localHeaderLock);
+  if (!localHeaderChecked) {
+    contentStreamStart = localHeaderOffset + readAndCheckLocalHeader(
+      stream, localHeaderOffset, rawFilename.data(), static_cast<uint16>(rawFilename.length()), counters);
+    localHeaderChecked = true;
+  }
+  return contentStreamStart;
+}
+
+DWORD64 ZipArchiveEntry::ResolveContentStreamStart(const byte* data, size_t length) {
+  concurrency::critical_section::scoped_lock lock(localHeaderLock);
+  if (!localHeaderChecked) {
+    contentStreamStart = localHeaderOffset + checkLocalHeader(
+      data, length, rawFilename.data(), static_cast<uint16>(rawFilename.length()));
+    localHeaderChecked = true;
   }
+  return contentStreamStart;
+}
+
+void ZipArchiveEntry::AppendToDirectoryIndex(std::vector<uint8_t>* output) {
+  DWORD64 start;
+  {
+    concurrency::critical_section::scoped_lock lock(localHeaderLock);
+    start = localHeaderChecked ? contentStreamStart : 0;
+  }
+  core::EntryInfo entry;
+  entry.record = centralDirectoryRecord;
+  entry.filename = rawFilename.data();
+  entry.filenameLength = static_cast<uint16_t>(rawFilename.length());
+  entry.compressedSize = compressedSize;
+  entry.uncompressedSize = uncompressedSize;
+  entry.localHeaderOffset = localHeaderOffset;
+  core::appendDirectoryIndexEntry(output, entry, start);
 }
 
 /************************************************************************/
@@ -138,192 +658,775 @@ void ZipArchiveEntry::ReadAndCheckLocalHeader(IInputStream^ stream) {
 /************************************************************************/
 IBuffer^ ZipArchiveEntry::UncompressedFromStream(IInputStream^ stream, 
                                               unsigned int maxBufSize,
-                                              const cancellation_token& cancellationToken) {
-  auto dataReader = ref new Windows::Storage::Streams::DataReader(stream);
-  uint32 bytesToRead = centralDirectoryRecord.compressedSize;
-  if (maxBufSize > 0 && maxBufSize < bytesToRead) {
-    bytesToRead = maxBufSize;
+                                              const cancellation_token& cancellationToken,
+                                              core::StatisticsCounters* counters) {
+  uint64 bytesToRead64 = compressedSize;
+  if (maxBufSize > 0 && maxBufSize < bytesToRead64) {
+    bytesToRead64 = maxBufSize;
   }
-
-  uint32 bytesRead = 0;
-  while (bytesRead < bytesToRead) {
-    concurrency::task<uint32> loadDataTask(dataReader->LoadAsync(bytesToRead-bytesRead));
-    bytesRead += loadDataTask.get();
+  if (bytesToRead64 > UINT32_MAX) {
+    throw ref new Platform::OutOfBoundsException(
+      L"File is too large to be read into memory: " + filename);
   }
+  uint32 bytesToRead = static_cast<uint32>(bytesToRead64);
 
-  Windows::Storage::Streams::IBuffer^ result = dataReader->ReadBuffer(bytesToRead);
+  auto result = ref new Windows::Storage::Streams::Buffer(bytesToRead);
+  readStreamIntoBuffer(stream, result, bytesToRead, counters);
   return result;
 }
 
 /************************************************************************/
-/* Decompress a file compressed using the DEFLATE algorithm             */
+/* Feed the compressed data from the stream through the inflater chunk  */
+/* by chunk, handing every piece of output to consumeOutput.            */
 /************************************************************************/
-IBuffer^ ZipArchiveEntry::DeflateFromStream(IInputStream^ stream, 
-                                            const cancellation_token& cancellationToken) {
-  IBuffer^ compressedBuffer = UncompressedFromStream(stream, 0, cancellationToken);
-  
-  if (cancellationToken.is_canceled()) { return nullptr; }
+void ZipArchiveEntry::InflateFromStream(
+  IInputStream^ stream,
+  core::Inflater& inflater,
+  const cancellation_token& cancellationToken,
+  core::StatisticsCounters* counters,
+  const std::function<void(const byte*, size_t)>& consumeOutput) {
+  std::shared_ptr<core::InflateIndex> index = CopyCheckpointIndex(true);
+  if (index) {
+    inflater.RecordCheckpoints(index.get());
+  }
+  ChunkedStreamReader reader(stream, compressedSize, counters);
+  const byte* input = nullptr;
+  uint32 inputAvailable = 0;
+  tinfl_status status;
+  do {
+    if (cancellationToken.is_canceled()) {
+      concurrency::cancel_current_task();
+    }
+    if (inputAvailable == 0 && reader.HasMoreData()) {
+      input = reader.NextChunk(&inputAvailable);
+    }
+    size_t inputSize = inputAvailable;
+    const byte* output;
+    size_t outputSize;
+    {
+      core::ScopedTimer inflating(&counters->inflateTime);
+      status = inflater.Inflate(input, &inputSize, reader.HasMoreData(), &output, &outputSize);
+    }
+    counters->bytesInflated += outputSize;
+    input += inputSize;
+    inputAvailable -= static_cast<uint32>(inputSize);
+    if (outputSize > 0) {
+      consumeOutput(output, outputSize);
+    }
+  } while ((status == TINFL_STATUS_HAS_MORE_OUTPUT && inflater.TotalOut() < uncompressedSize) || 
+           (status == TINFL_STATUS_NEEDS_MORE_INPUT && reader.HasMoreData()));
 
-  auto compressedBufferByteAccess = getByteAccessForBuffer(compressedBuffer);
-  byte* data;
-  compressedBufferByteAccess->Buffer(&data);
-  // allocate buffer for decompression
-  Platform::Array<byte>^ decompressedData = 
-    ref new Platform::Array<byte>(centralDirectoryRecord.uncompressedSize);
-
-  auto decompressionResult = tinfl_decompress_mem_to_mem(
-    decompressedData->Data,
-    centralDirectoryRecord.uncompressedSize, 
-    data, 
-    centralDirectoryRecord.compressedSize, 
-    0);
-
-  if (decompressionResult != centralDirectoryRecord.uncompressedSize) {
+  if (status != TINFL_STATUS_DONE || inflater.TotalOut() != uncompressedSize) {
+    throw ref new Platform::FailureException(L"Could not extract data for file " + filename);
+  }
+  CheckCrc32(inflater.Crc32());
+  if (index) {
+    KeepCheckpointIndex(index, true);
+  }
+}
+
+/************************************************************************/
+/* Inflate just the range [offset, offset + length) of the file. The    */
+/* data is decompressed from the last checkpoint in front of the range  */
+/* and decompression stops as soon as the range is complete, so the     */
+/* CRC-32 can't be checked. Checkpoints passed on the way are added to  */
+/* the index if checkpoints are being recorded.                         */
+/************************************************************************/
+IBuffer^ ZipArchiveEntry::InflateRange(IRandomAccessStream^ stream,
+                                       uint64 offset,
+                                       uint32 length,
+                                       const cancellation_token& cancellationToken,
+                                       core::StatisticsCounters* counters) {
+  std::shared_ptr<core::InflateIndex> index = CopyCheckpointIndex(false);
+  std::shared_ptr<const core::InflateCheckpoint> checkpoint;
+  if (index) {
+    checkpoint = index->FindCheckpoint(offset);
+  }
+  core::PooledInflater inflater = checkpoint ? core::acquireInflater(*checkpoint) : core::acquireInflater();
+  if (index) {
+    inflater->RecordCheckpoints(index.get());
+  }
+  uint64 inputStart = checkpoint ? checkpoint->inputOffset : 0;
+  ChunkedStreamReader reader(
+    stream->GetInputStreamAt(ResolveContentStreamStart(stream, counters) + inputStart), 
+    compressedSize - inputStart,
+    counters);
+
+  auto result = ref new Windows::Storage::Streams::Buffer(length);
+  byte* target = getBufferData(result);
+  uint64 end = offset + length;
+  const byte* input = nullptr;
+  uint32 inputAvailable = 0;
+  tinfl_status status;
+  do {
+    if (cancellationToken.is_canceled()) {
+      concurrency::cancel_current_task();
+    }
+    if (inputAvailable == 0 && reader.HasMoreData()) {
+      input = reader.NextChunk(&inputAvailable);
+    }
+    size_t inputSize = inputAvailable;
+    const byte* output;
+    size_t outputSize;
+    {
+      core::ScopedTimer inflating(&counters->inflateTime);
+      status = inflater->Inflate(input, &inputSize, reader.HasMoreData(), &output, &outputSize);
+    }
+    counters->bytesInflated += outputSize;
+    input += inputSize;
+    inputAvailable -= static_cast<uint32>(inputSize);
+
+    // copy the part of the output that falls into the range
+    uint64 outputEnd = inflater->TotalOut();
+    uint64 outputStart = outputEnd - outputSize;
+    if (outputEnd > offset && outputStart < end) {
+      uint64 copyStart = max(outputStart, offset);
+      uint64 copyEnd = min(outputEnd, end);
+      memcpy(target + (copyStart - offset), output + (copyStart - outputStart), 
+        static_cast<size_t>(copyEnd - copyStart));
+    }
+  } while (inflater->TotalOut() < end && 
+           (status == TINFL_STATUS_HAS_MORE_OUTPUT || 
+            (status == TINFL_STATUS_NEEDS_MORE_INPUT && reader.HasMoreData())));
+
+  if (inflater->TotalOut() < end) {
     throw ref new Platform::FailureException(L"Could not extract data for file " + filename);
   }
+  if (index) {
+    KeepCheckpointIndex(index, false);
+  }
+  result->Length = length;
+  return result;
+}
+
+/************************************************************************/
+/* Checkpoint indexes are never changed once they're kept by the entry, */
+/* inflating records into a copy that replaces the kept index if it     */
+/* turns out to have more checkpoints. Returns null if there is nothing */
+/* to record into or, for range reads, to resume from.                  */
+/************************************************************************/
+std::shared_ptr<core::InflateIndex> ZipArchiveEntry::CopyCheckpointIndex(bool forFullInflate) {
+  concurrency::critical_section::scoped_lock lock(indexLock);
+  if (forFullInflate) {
+    // a complete index with the same spacing would come out just the same
+    if (checkpointSpacing == 0 || 
+        (checkpointIndexComplete && checkpointIndex->Spacing() == checkpointSpacing)) {
+      return nullptr;
+    }
+  } else if (checkpointIndex) {
+    return std::make_shared<core::InflateIndex>(*checkpointIndex);
+  } else if (checkpointSpacing == 0) {
+    return nullptr;
+  }
+  return std::make_shared<core::InflateIndex>(
+    checkpointSpacing, compressedSize, uncompressedSize, centralDirectoryRecord.crc32);
+}
+
+void ZipArchiveEntry::KeepCheckpointIndex(const std::shared_ptr<core::InflateIndex>& index, bool complete) {
+  concurrency::critical_section::scoped_lock lock(indexLock);
+  if (complete || 
+      !checkpointIndex ||
+      (!checkpointIndexComplete && index->CheckpointCount() > checkpointIndex->CheckpointCount())) {
+    checkpointIndex = index;
+    checkpointIndexComplete = complete;
+  }
+}
 
-  Windows::Storage::Streams::DataWriter^ writer = ref new Windows::Storage::Streams::DataWriter();
-  writer->WriteBytes(decompressedData);
-  return writer->DetachBuffer();
+void ZipArchiveEntry::SetCheckpointSpacing(uint64 spacing) {
+  concurrency::critical_section::scoped_lock lock(indexLock);
+  checkpointSpacing = spacing;
 }
 
-int __cdecl decompressCallback(const void *buf, int len, void *pUser) {
-  auto outFile = reinterpret_cast<FILE*>(pUser);
-  if (fwrite(buf, 1, len, outFile) == len) {
-    return 1;
-  } else {
-    return 0;
+IBuffer^ ZipArchiveEntry::SaveCheckpointIndex() {
+  std::shared_ptr<core::InflateIndex> index;
+  {
+    concurrency::critical_section::scoped_lock lock(indexLock);
+    index = checkpointIndex;
+  }
+  if (!index) {
+    return nullptr;
+  }
+  std::vector<uint8_t> data;
+  index->Serialize(&data);
+  auto result = ref new Windows::Storage::Streams::Buffer(static_cast<uint32>(data.size()));
+  memcpy(getBufferData(result), data.data(), data.size());
+  result->Length = static_cast<uint32>(data.size());
+  return result;
+}
+
+void ZipArchiveEntry::LoadCheckpointIndex(IBuffer^ data) {
+  std::shared_ptr<core::InflateIndex> index = std::make_shared<core::InflateIndex>();
+  if (data == nullptr ||
+      !core::InflateIndex::Deserialize(getBufferData(data), data->Length, index.get()) ||
+      !index->Matches(compressedSize, uncompressedSize, centralDirectoryRecord.crc32)) {
+    throw ref new Platform::InvalidArgumentException(L"Not a checkpoint index for file " + filename);
+  }
+  concurrency::critical_section::scoped_lock lock(indexLock);
+  checkpointIndex = index;
+  checkpointIndexComplete = false;
+}
+
+/************************************************************************/
+/* Decompress a file compressed using the DEFLATE algorithm. The data   */
+/* is inflated straight into the buffer that is returned to the caller. */
+/************************************************************************/
+IBuffer^ ZipArchiveEntry::DeflateFromStream(IInputStream^ stream, 
+                                            const cancellation_token& cancellationToken,
+                                            core::StatisticsCounters* counters,
+                                            const ProgressCallback& reportProgress) {
+  if (uncompressedSize > UINT32_MAX) {
+    throw ref new Platform::OutOfBoundsException(
+      L"File is too large to be read into memory: " + filename);
+  }
+  uint32 length = static_cast<uint32>(uncompressedSize);
+  auto result = ref new Windows::Storage::Streams::Buffer(length);
+  core::PooledInflater inflater = core::acquireInflater(getBufferData(result), length);
+  InflateFromStream(stream, *inflater, cancellationToken, counters, 
+    [&reportProgress](const byte*, size_t length) {
+    if (reportProgress) {
+      reportProgress(length);
+    }
+  });
+  result->Length = length;
+  return result;
+}
+
+/************************************************************************/
+/* Decompress a file whose data has already been read into memory       */
+/************************************************************************/
+IBuffer^ ZipArchiveEntry::UncompressedFromMemory(const byte* data, core::StatisticsCounters* counters) {
+  if (uncompressedSize > UINT32_MAX) {
+    throw ref new Platform::OutOfBoundsException(
+      L"File is too large to be read into memory: " + filename);
+  }
+  uint32 length = static_cast<uint32>(uncompressedSize);
+  auto result = ref new Windows::Storage::Streams::Buffer(length);
+  uint32 crc;
+  switch (centralDirectoryRecord.compressionMethod) {
+  case 0: // file is uncompressed
+    if (compressedSize != uncompressedSize) {
+      throw ref new Platform::FailureException(L"Could not extract data for file " + filename);
+    }
+    memcpy(getBufferData(result), data, length);
+    crc = core::updateCrc32(0, data, length);
+    break;
+  case 8: { // deflate
+    core::ScopedTimer inflating(&counters->inflateTime);
+    if (!core::inflateToSpan(data, static_cast<size_t>(compressedSize), getBufferData(result), length, &crc)) {
+      throw ref new Platform::FailureException(L"Could not extract data for file " + filename);
+    }
+    counters->bytesInflated += length;
+    break;
   }
+  default:
+    throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
+      centralDirectoryRecord.compressionMethod);
+  }
+  CheckCrc32(crc);
+  result->Length = length;
+  return result;
 }
 
+/************************************************************************/
+/* Inflate a DEFLATE compressed file straight to disk. The compressed   */
+/* data is read in chunks and fed to the decompressor as it arrives, so */
+/* memory usage is bounded by the chunk size plus the 32 KB dictionary, */
+/* independent of the size of the entry.                                */
+/************************************************************************/
 void ZipArchiveEntry::DeflateFromStreamToFile( 
   Windows::Storage::Streams::IInputStream^ in, 
   FILE* out, 
-  const concurrency::cancellation_token& cancellationToken ) {
-    // for now just read the whole uncompressed buffer into memory
-    // this can probably be optimized later on
-    IBuffer^ compressedBuffer = UncompressedFromStream(in, 0, cancellationToken);
-
-    if (cancellationToken.is_canceled()) { return; }
-
-    auto compressedBufferByteAccess = getByteAccessForBuffer(compressedBuffer);
-    byte* data;
-    compressedBufferByteAccess->Buffer(&data);
-    size_t compressedBufferSize = compressedBuffer->Length;
-    auto decompressionResult = tinfl_decompress_mem_to_callback(
-      data,
-      &compressedBufferSize, 
-      decompressCallback, 
-      reinterpret_cast<void*>(out), 
-      0);
-
-    if (decompressionResult != 1) {
-      throw ref new Platform::FailureException(L"Could not extract data for file " + filename);
-    }
+  const concurrency::cancellation_token& cancellationToken,
+  core::StatisticsCounters* counters,
+  const ProgressCallback& reportProgress ) {
+    core::PooledInflater inflater = core::acquireInflater();
+    InflateFromStream(in, *inflater, cancellationToken, counters, 
+      [this, out, counters, &reportProgress](const byte* data, size_t length) {
+      writeToFile(out, data, length, filename, counters);
+      if (reportProgress) {
+        reportProgress(length);
+      }
+    });
 }
 
 #define BUFSIZE 1024*1024
 void ZipArchiveEntry::CopyFromStreamToFile(Windows::Storage::Streams::IInputStream^ stream, 
   FILE* out, 
-  const concurrency::cancellation_token& cancellationToken ) {
-    unsigned int written = 0;
-    while (written < centralDirectoryRecord.uncompressedSize) {
+  const concurrency::cancellation_token& cancellationToken,
+  core::StatisticsCounters* counters,
+  const ProgressCallback& reportProgress ) {
+    uint64 written = 0;
+    uint32 crc = 0;
+    while (written < uncompressedSize) {
       if (cancellationToken.is_canceled()) {
         concurrency::cancel_current_task();
       }
-      unsigned int bytesToRead = min(BUFSIZE, centralDirectoryRecord.uncompressedSize-written);
-      IBuffer^ buf = UncompressedFromStream(stream, bytesToRead, cancellationToken);
-      auto compressedBufferByteAccess = getByteAccessForBuffer(buf);
-      byte* data;
-      compressedBufferByteAccess->Buffer(&data);
-      fwrite(data, sizeof(byte), buf->Length, out);
+      unsigned int bytesToRead = static_cast<unsigned int>(min((uint64)BUFSIZE, uncompressedSize-written));
+      IBuffer^ buf = UncompressedFromStream(stream, bytesToRead, cancellationToken, counters);
+      byte* data = getBufferData(buf);
+      crc = core::updateCrc32(crc, data, buf->Length);
+      writeToFile(out, data, buf->Length, filename, counters);
       written += buf->Length;
+      if (reportProgress) {
+        reportProgress(buf->Length);
+      }
     }
+    CheckCrc32(crc);
 }
 
 IAsyncAction^ ZipArchiveEntry::ExtractAsync(IRandomAccessStream^ stream, 
   Windows::Storage::IStorageFile^ destination) {
   return concurrency::create_async([=](cancellation_token cancellationToken) {
-    FILE* fileHandle;
-    auto openResult = _wfopen_s(&fileHandle, destination->Path->Data(), L"wb");
-    if (openResult != 0) {
-      throw ref new Platform::AccessDeniedException("Could not write to file " + destination->Path);
-    }
-    auto outFile = std::shared_ptr<FILE>(fileHandle, [](FILE* ptr) {
-      fclose(ptr);
-    });
-    IInputStream^ zipArchiveDataInputStream = stream->GetInputStreamAt(contentStreamStart);
-    switch (centralDirectoryRecord.compressionMethod) {
-      case 0: // file is uncompressed, read it in chunks
-        CopyFromStreamToFile(zipArchiveDataInputStream, outFile.get(), cancellationToken);
-        break;
-      case 8: // deflate
-        DeflateFromStreamToFile(zipArchiveDataInputStream, outFile.get(), cancellationToken);
-        break;
-    }
+    ExtractToFile(stream, destination, cancellationToken, nullptr);
+  });
+}
+
+/************************************************************************/
+/* Extract the file synchronously, for callers that already run on a    */
+/* worker thread                                                        */
+/************************************************************************/
+static std::shared_ptr<FILE> openFileForWriting(Windows::Storage::IStorageFile^ file) {
+  FILE* fileHandle;
+  auto openResult = _wfopen_s(&fileHandle, file->Path->Data(), L"wb");
+  if (openResult != 0) {
+    throw ref new Platform::AccessDeniedException("Could not write to file " + file->Path);
+  }
+  return std::shared_ptr<FILE>(fileHandle, [](FILE* ptr) {
+    fclose(ptr);
   });
 }
 
+void ZipArchiveEntry::ExtractToFile(IRandomAccessStream^ stream, 
+                                    Windows::Storage::IStorageFile^ destination,
+                                    const cancellation_token& cancellationToken,
+                                    const ProgressCallback& reportProgress) {
+  RecordedOperation operation(statistics, filename, ZipArchiveEntryOperation::Extract);
+  auto outFile = openFileForWriting(destination);
+  IInputStream^ zipArchiveDataInputStream = 
+    stream->GetInputStreamAt(ResolveContentStreamStart(stream, &operation.counters));
+  switch (centralDirectoryRecord.compressionMethod) {
+    case 0: // file is uncompressed, read it in chunks
+      CopyFromStreamToFile(zipArchiveDataInputStream, outFile.get(), cancellationToken, 
+        &operation.counters, reportProgress);
+      break;
+    case 8: // deflate
+      DeflateFromStreamToFile(zipArchiveDataInputStream, outFile.get(), cancellationToken, 
+        &operation.counters, reportProgress);
+      break;
+  }
+}
+
 IAsyncOperation<IBuffer^>^ ZipArchiveEntry::GetUncompressedFileContents(
   IRandomAccessStream^ stream) {
   return concurrency::create_async([=](cancellation_token cancellationToken) {
-    IInputStream^ zipArchiveDataInputStream = stream->GetInputStreamAt(contentStreamStart);
-    switch (centralDirectoryRecord.compressionMethod) {
-    case 0:  // file is uncompressed
-      return UncompressedFromStream(zipArchiveDataInputStream, 0, cancellationToken);
-    case 8: // deflate
-      return DeflateFromStream(zipArchiveDataInputStream, cancellationToken);
-    default:
-      throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
-        centralDirectoryRecord.compressionMethod);
-    }
+    return ReadContents(stream, cancellationToken, nullptr);
   });
 }
 
+// the whole uncompressed file, stored files are reported as a single piece
+IBuffer^ ZipArchiveEntry::ReadContents(IRandomAccessStream^ stream,
+                                       const cancellation_token& cancellationToken,
+                                       const ProgressCallback& reportProgress) {
+  RecordedOperation operation(statistics, filename, ZipArchiveEntryOperation::ReadContents);
+  IInputStream^ zipArchiveDataInputStream = 
+    stream->GetInputStreamAt(ResolveContentStreamStart(stream, &operation.counters));
+  switch (centralDirectoryRecord.compressionMethod) {
+  case 0: { // file is uncompressed
+    IBuffer^ contents = UncompressedFromStream(zipArchiveDataInputStream, 0, cancellationToken, &operation.counters);
+    CheckCrc32(core::updateCrc32(0, getBufferData(contents), contents->Length));
+    if (reportProgress) {
+      reportProgress(contents->Length);
+    }
+    return contents;
+  }
+  case 8: // deflate
+    return DeflateFromStream(zipArchiveDataInputStream, cancellationToken, &operation.counters, reportProgress);
+  default:
+    throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
+      centralDirectoryRecord.compressionMethod);
+  }
+}
+
+/************************************************************************/
+/* Read a range of the uncompressed file. Stored files are read at the  */
+/* offset right away, deflated ones are inflated up to the range's end. */
+/************************************************************************/
+IBuffer^ ZipArchiveEntry::GetFileRange(IRandomAccessStream^ stream,
+                                       uint64 offset,
+                                       uint32 length,
+                                       const cancellation_token& cancellationToken) {
+  if (offset > uncompressedSize) {
+    throw ref new Platform::OutOfBoundsException(L"Range starts past the end of file " + filename);
+  }
+  length = static_cast<uint32>(min((uint64)length, uncompressedSize - offset));
+  if (length == 0) {
+    return ref new Windows::Storage::Streams::Buffer(0);
+  }
+  RecordedOperation operation(statistics, filename, ZipArchiveEntryOperation::ReadRange);
+  switch (centralDirectoryRecord.compressionMethod) {
+  case 0: { // file is uncompressed
+    auto result = ref new Windows::Storage::Streams::Buffer(length);
+    readStreamIntoBuffer(
+      stream->GetInputStreamAt(ResolveContentStreamStart(stream, &operation.counters) + offset), 
+      result, length, &operation.counters);
+    return result;
+  }
+  case 8: // deflate
+    return InflateRange(stream, offset, length, cancellationToken, &operation.counters);
+  default:
+    throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
+      centralDirectoryRecord.compressionMethod);
+  }
+}
+
 /************************************************************************/
 /* Instantiate the ZipArchive and read its directory of contents        */
 /************************************************************************/
-ZipArchive::ZipArchive(IRandomAccessStream^ stream, cancellation_token cancellationToken) {
+ZipArchive::ZipArchive(IRandomAccessStream^ stream, 
+                       ZipArchiveOpenMode openMode, 
+                       cancellation_token cancellationToken,
+                       uint64 lastModified,
+                       IBuffer^ directoryIndex) : 
+  checkpointSpacing(0),
+  ignoreCase(false),
+  statistics(std::make_shared<StatisticsCollector>()),
+  contentCache(std::make_shared<ContentCache>(statistics)),
+  directoryIndexUsed(false) {
   randomAccessStream = stream;
+  RecordedOperation open(statistics);
+  core::ScopedTimer parsing(&open.counters.directoryParseTime);
+
+  // the central directory record is located at the end of the file, 
+  // for ZIP64 archives it is preceded by the ZIP64 locator
+  if (randomAccessStream->Size < sizeof(core::EndOfCentralDirectoryRecord)) {
+    throw ref new Platform::FailureException("Could not read ZIP file");
+  }
+  uint32 tailLength = sizeof(core::EndOfCentralDirectoryRecord);
+  if (randomAccessStream->Size >= tailLength + sizeof(core::Zip64EndOfCentralDirectoryLocator)) {
+    tailLength += sizeof(core::Zip64EndOfCentralDirectoryLocator);
+  }
+  byte tail[sizeof(core::EndOfCentralDirectoryRecord) + sizeof(core::Zip64EndOfCentralDirectoryLocator)];
+  readBytesFromStream(
+    randomAccessStream,
+    randomAccessStream->Size - tailLength,
+    tailLength, 
+    tail, 
+    sizeof(tail),
+    &open.counters);
 
-  // the central directory record is located at the end of the file
-  randomAccessStream->Seek(randomAccessStream->Size - sizeof(EndOfCentralDirectoryRecord));
-  auto dataReader = ref new Windows::Storage::Streams::DataReader(randomAccessStream);
-  readBytesFromDataReader(
-    dataReader, 
-    sizeof(ZipArchive::EndOfCentralDirectoryRecord), 
-    &endOfCentralDirectoryRecord, 
-    sizeof(endOfCentralDirectoryRecord));
-  dataReader->DetachStream(); // done reading but keep the stream usuable
-
-  if (endOfCentralDirectoryRecord.signature != ZipArchive_END_OF_CENTRAL_RECORD_SIGNATURE) {
+  core::CentralDirectoryLocation location;
+  if (!core::readEndOfCentralDirectory(tail, tailLength, &location)) {
     throw ref new Platform::FailureException("Could not read ZIP file");
   }
   if (cancellationToken.is_canceled()) {
     return;
   }
-  archiveEntries = ref new Array<ZipArchiveEntry^>(endOfCentralDirectoryRecord.entryCountThisDisk);
-  stream->Seek(endOfCentralDirectoryRecord.centralDirectoryOffset);
-  for (int i = 0; i < endOfCentralDirectoryRecord.entryCountThisDisk; i++) {
-    archiveEntries[i] = ref new ZipArchiveEntry(randomAccessStream);
-    if (cancellationToken.is_canceled()) {
-      return;
-    }
+
+  fingerprint.archiveSize = randomAccessStream->Size;
+  fingerprint.lastModified = lastModified;
+  fingerprint.tailCrc32 = core::updateCrc32(0, tail, tailLength);
+  if (directoryIndex != nullptr && ReadDirectoryIndex(directoryIndex)) {
+    directoryIndexUsed = true;
+    return;
   }
-}
+
+  if (location.hasZip64Record) {
+    if (location.zip64RecordOffset + sizeof(core::Zip64EndOfCentralDirectoryRecord) > 
+        randomAccessStream->Size) {
+      throw ref new Platform::FailureException("Could not read ZIP file");
+    }
+    byte zip64Record[sizeof(core::Zip64EndOfCentralDirectoryRecord)];
+    readBytesFromStream(
+      randomAccessStream,
+      location.zip64RecordOffset,
+      sizeof(zip64Record),
+      zip64Record,
+      sizeof(zip64Record),
+      &open.counters);
+    if (!core::readZip64EndOfCentralDirectory(zip64Record, sizeof(zip64Record), &location)) {
+      throw ref new Platform::FailureException("Could not read ZIP64 end of central directory");
+    }
+  }
+  uint64 entryCount = location.entryCount;
+  uint64 directorySize = location.size;
+  uint64 directoryOffset = location.offset;
+
+  if (directoryOffset + directorySize > randomAccessStream->Size || 
+      directorySize > UINT32_MAX || 
+      entryCount > UINT32_MAX) {
+    throw ref new Platform::FailureException("Could not read ZIP file");
+  }
+
+  // fetch the whole central directory with one read and parse it from memory
+  std::unique_ptr<byte[]> directory(new byte[static_cast<size_t>(directorySize)]);
+  readBytesFromStream(
+    randomAccessStream, 
+    directoryOffset, 
+    static_cast<uint32>(directorySize), 
+    directory.get(), 
+    static_cast<size_t>(directorySize),
+    &open.counters);
+
+  // every record takes at least its fixed part, a larger count is caught while parsing
+  entryTable.Reserve(static_cast<size_t>(
+    min(entryCount, directorySize / sizeof(core::CentralDirectoryRecord))));
+  const byte* record = directory.get();
+  const byte* recordsEnd = directory.get() + static_cast<size_t>(directorySize);
+  for (uint64 i = 0; i < entryCount; i++) {
+    core::EntryInfo entry;
+    if (!core::readCentralDirectoryEntry(&record, recordsEnd, &entry)) {
+      throw ref new Platform::FailureException(L"Invalid ZIP file entry header");
+    }
+    // unless the archive is opened with CentralDirectoryOnly, the local
+    // headers are read and checked right away
+    uint64 contentStart = 0;
+    if (openMode == ZipArchiveOpenMode::ValidateLocalHeaders) {
+      contentStart = entry.localHeaderOffset + readAndCheckLocalHeader(
+        randomAccessStream, entry.localHeaderOffset, entry.filename, entry.filenameLength, &open.counters);
+    }
+    if (!entryTable.Add(entry, contentStart)) {
+      throw ref new Platform::FailureException(L"Invalid ZIP file entry header");
+    }
+    if (cancellationToken.is_canceled()) {
+      return;
+    }
+  }
+  entryTable.BuildLookup();
+}
+
+/************************************************************************/
+/* Take the entries from a directory index instead of the central       */
+/* directory. Returns false, leaving the archive as it was, if the      */
+/* index belongs to a different archive or is damaged.                  */
+/************************************************************************/
+bool ZipArchive::ReadDirectoryIndex(IBuffer^ directoryIndex) {
+  const byte* data = getBufferData(directoryIndex);
+  const byte* end = data + directoryIndex->Length;
+  core::ArchiveFingerprint savedFingerprint;
+  uint64 entryCount;
+  if (!core::readDirectoryIndexHeader(&data, end, &savedFingerprint, &entryCount) ||
+      !(savedFingerprint == fingerprint) ||
+      entryCount > UINT32_MAX) {
+    return false;
+  }
+  core::EntryTable entries;
+  entries.Reserve(static_cast<size_t>(entryCount));
+  for (uint64 i = 0; i < entryCount; i++) {
+    core::EntryInfo entry;
+    uint64 contentStart;
+    if (!core::readDirectoryIndexEntry(&data, end, &entry, &contentStart) ||
+        !entries.Add(entry, contentStart)) {
+      return false;
+    }
+  }
+  entries.BuildLookup();
+  entryTable.Swap(entries);
+  return true;
+}
+
+IBuffer^ ZipArchive::SaveDirectoryIndex() {
+  std::vector<uint8_t> data;
+  core::appendDirectoryIndexHeader(&data, fingerprint, entryTable.Count());
+  {
+    // entries in use may have read their local header since the table was filled
+    concurrency::critical_section::scoped_lock lock(entryObjectsLock);
+    for (unsigned int i = 0; i < entryTable.Count(); i++) {
+      if (entryObjects != nullptr && entryObjects[i] != nullptr) {
+        entryObjects[i]->AppendToDirectoryIndex(&data);
+      } else {
+        core::appendDirectoryIndexEntry(&data, entryTable.Entry(i), entryTable.ContentStart(i));
+      }
+    }
+  }
+  auto result = ref new Windows::Storage::Streams::Buffer(static_cast<uint32>(data.size()));
+  memcpy(getBufferData(result), data.data(), data.size());
+  result->Length = static_cast<uint32>(data.size());
+  return result;
+}
+
+// the object of an entry, created on first use
+ZipArchiveEntry^ ZipArchive::GetEntry(unsigned int index) {
+  concurrency::critical_section::scoped_lock lock(entryObjectsLock);
+  return EntryObject(index);
+}
+
+// same, with entryObjectsLock held
+ZipArchiveEntry^ ZipArchive::EntryObject(unsigned int index) {
+  if (entryObjects == nullptr) {
+    entryObjects = ref new Array<ZipArchiveEntry^>(static_cast<unsigned int>(entryTable.Count()));
+  }
+  if (entryObjects[index] == nullptr) {
+    auto entry = ref new ZipArchiveEntry(entryTable.Entry(index), entryTable.ContentStart(index), statistics);
+    entry->SetCheckpointSpacing(checkpointSpacing);
+    entryObjects[index] = entry;
+  }
+  return entryObjects[index];
+}
+
+Array<ZipArchiveEntry^>^ ZipArchive::Files::get() {
+  concurrency::critical_section::scoped_lock lock(entryObjectsLock);
+  if (entryObjects == nullptr) {
+    entryObjects = ref new Array<ZipArchiveEntry^>(static_cast<unsigned int>(entryTable.Count()));
+  }
+  for (unsigned int i = 0; i < entryObjects->Length; i++) {
+    EntryObject(i);
+  }
+  return entryObjects;
+}
+
+IVectorView<ZipArchiveEntry^>^ ZipArchive::GetEntries(const std::vector<size_t>& indexes) {
+  auto result = ref new Platform::Collections::Vector<ZipArchiveEntry^>();
+  for (size_t i = 0; i < indexes.size(); i++) {
+    result->Append(GetEntry(static_cast<unsigned int>(indexes[i])));
+  }
+  return result->GetView();
+}
+
+void ZipArchive::SortFilenames() {
+  concurrency::critical_section::scoped_lock lock(sortedFilenamesLock);
+  if (!entryTable.FilenamesSorted()) {
+    entryTable.SortFilenames();
+  }
+}
+
+IVectorView<ZipArchiveEntry^>^ ZipArchive::GetEntriesInFolder(String^ folder, boolean recursive) {
+  std::vector<size_t> entries;
+  if (ignoreCase) {
+    std::string foldedFolder;
+    if (folder != nullptr) {
+      foldedFolder = foldFilenameCase(folder->Data(), folder->Length());
+    }
+    if (!foldedFolder.empty() && foldedFolder[foldedFolder.length() - 1] != '/') {
+      foldedFolder += '/';
+    }
+    SortFoldedFilenames();
+    entryTable.FoldedEntriesInFolder(foldedFolder.data(), foldedFolder.length(), recursive != 0, &entries);
+    return GetEntries(entries);
+  }
+  std::string encodedFolders[2];
+  LookupEncoding encodings[2];
+  int encodingCount = encodeForLookup(folder, encodedFolders, encodings);
+  SortFilenames();
+  for (int i = 0; i < encodingCount; i++) {
+    std::string& encodedFolder = encodedFolders[i];
+    if (!encodedFolder.empty() && encodedFolder[encodedFolder.length() - 1] != '/') {
+      encodedFolder += '/';
+    }
+    std::vector<size_t> found;
+    entryTable.EntriesInFolder(encodedFolder.data(), encodedFolder.length(), recursive != 0, &found);
+    appendStoredAs(entryTable, found, encodings[i], &entries);
+  }
+  if (encodingCount > 1) {
+    std::sort(entries.begin(), entries.end(), [this](size_t a, size_t b) {
+      return entryTable.FilenameLess(a, b);
+    });
+  }
+  return GetEntries(entries);
+}
+
+IVectorView<ZipArchiveEntry^>^ ZipArchive::FindEntries(String^ pattern) {
+  std::vector<size_t> entries;
+  if (pattern == nullptr) {
+    return GetEntries(entries);
+  }
+  if (ignoreCase) {
+    std::string foldedPattern = foldFilenameCase(pattern->Data(), pattern->Length());
+    SortFoldedFilenames();
+    entryTable.FoldedEntriesMatching(foldedPattern.data(), foldedPattern.length(), &entries);
+    return GetEntries(entries);
+  }
+  std::string encodedPatterns[2];
+  LookupEncoding encodings[2];
+  int encodingCount = encodeForLookup(pattern, encodedPatterns, encodings);
+  SortFilenames();
+  for (int i = 0; i < encodingCount; i++) {
+    std::vector<size_t> found;
+    entryTable.EntriesMatching(encodedPatterns[i].data(), encodedPatterns[i].length(), &found);
+    appendStoredAs(entryTable, found, encodings[i], &entries);
+  }
+  if (encodingCount > 1) {
+    std::sort(entries.begin(), entries.end(), [this](size_t a, size_t b) {
+      return entryTable.FilenameLess(a, b);
+    });
+  }
+  return GetEntries(entries);
+}
+
+/************************************************************************/
+/* Case insensitive lookups and queries need the folded names of all    */
+/* entries, which are only worked out once the first of them comes      */
+/* along, and then searched like the filenames themselves.              */
+/************************************************************************/
+void ZipArchive::SortFoldedFilenames() {
+  concurrency::critical_section::scoped_lock lock(foldedFilenamesLock);
+  if (!entryTable.FoldedFilenamesSorted()) {
+    for (size_t i = 0; i < entryTable.Count(); i++) {
+      std::wstring wideFilename = decodeFilename(
+        entryTable.Filename(i), entryTable.FilenameLength(i), entryTable.Utf8Filename(i));
+      std::string folded = foldFilenameCase(wideFilename.data(), wideFilename.length());
+      entryTable.AddFoldedFilename(folded.data(), folded.length());
+    }
+    entryTable.SortFoldedFilenames();
+  }
+}
+
+bool ZipArchive::FindEntryIndex(String^ filename, unsigned int* index) {
+  if (filename == nullptr) {
+    return false;
+  }
+  if (ignoreCase) {
+    std::string folded = foldFilenameCase(filename->Data(), filename->Length());
+    size_t found;
+    SortFoldedFilenames();
+    if (!entryTable.FindFolded(folded.data(), folded.length(), &found)) {
+      return false;
+    }
+    *index = static_cast<unsigned int>(found);
+    return true;
+  }
+  std::string encodedFilenames[2];
+  LookupEncoding encodings[2];
+  int encodingCount = encodeForLookup(filename, encodedFilenames, encodings);
+  for (int i = 0; i < encodingCount; i++) {
+    size_t found;
+    if (entryTable.Find(encodedFilenames[i].data(), encodedFilenames[i].length(), &found) &&
+        isStoredAs(entryTable, found, encodings[i])) {
+      *index = static_cast<unsigned int>(found);
+      return true;
+    }
+  }
+  return false;
+}
+
+ZipArchiveEntry^ ZipArchive::FindEntry(String^ filename) {
+  unsigned int index;
+  return FindEntryIndex(filename, &index) ? GetEntry(index) : nullptr;
+}
 
 /************************************************************************/
 /* Constructor function to create a zip archive from a stream reference */
 /************************************************************************/
 IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromStreamReferenceAsync(
   Windows::Storage::Streams::RandomAccessStreamReference^ reference) {
+  return CreateFromStreamReferenceAsync(reference, ZipArchiveOpenMode::ValidateLocalHeaders);
+}
+
+IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromStreamReferenceAsync(
+  Windows::Storage::Streams::RandomAccessStreamReference^ reference, ZipArchiveOpenMode openMode) {
+  return CreateFromStreamReferenceAsync(reference, openMode, nullptr);
+}
+
+IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromStreamReferenceAsync(
+  Windows::Storage::Streams::RandomAccessStreamReference^ reference, 
+  ZipArchiveOpenMode openMode,
+  IBuffer^ directoryIndex) {
   return concurrency::create_async([=](cancellation_token cancellationToken) -> ZipArchive^ {
     auto streamOpenTask = 
       concurrency::task<Windows::Storage::Streams::IRandomAccessStreamWithContentType^>(
       reference->OpenReadAsync());
     auto createZipArchiveTask = streamOpenTask.then(
       [=](Windows::Storage::Streams::IRandomAccessStreamWithContentType^ stream) -> ZipArchive^ {
-      return ref new ZipArchive(stream, cancellationToken);
+      return ref new ZipArchive(stream, openMode, cancellationToken, 0, directoryIndex);
     }, concurrency::task_continuation_context::use_arbitrary());
     return createZipArchiveTask.get();
   });
@@ -333,84 +1436,946 @@ IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromStreamReferenceAsync(
 /* Instantiate a ZipArchive object from an IStorageFile                 */
 /************************************************************************/
 IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromFileAsync(IStorageFile^ file) {
+  return CreateFromFileAsync(file, ZipArchiveOpenMode::ValidateLocalHeaders);
+}
+
+IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromFileAsync(IStorageFile^ file, 
+                                                              ZipArchiveOpenMode openMode) {
+  return CreateFromFileAsync(file, openMode, nullptr);
+}
+
+IAsyncOperation<ZipArchive^>^ ZipArchive::CreateFromFileAsync(IStorageFile^ file, 
+                                                              ZipArchiveOpenMode openMode,
+                                                              IBuffer^ directoryIndex) {
   return concurrency::create_async([=](cancellation_token cancellationToken) -> ZipArchive^ {
     auto fileOpenTask = concurrency::task<IRandomAccessStream^>(
       file->OpenAsync(Windows::Storage::FileAccessMode::Read));
+    // the modification time is part of the key of directory indexes
+    auto propertiesTask = concurrency::task<Windows::Storage::FileProperties::BasicProperties^>(
+      file->GetBasicPropertiesAsync());
     auto createZipArchiveTask = fileOpenTask.then([=](IRandomAccessStream^ stream) -> ZipArchive^ {
-      return ref new ZipArchive(stream, cancellationToken);
+      uint64 lastModified = propertiesTask.get()->DateModified.UniversalTime;
+      return ref new ZipArchive(stream, openMode, cancellationToken, lastModified, directoryIndex);
     } , concurrency::task_continuation_context::use_arbitrary());
     return createZipArchiveTask.get();
     });
 }
 
+/************************************************************************/
+/* Uncompressed contents of recently read entries, keyed by their       */
+/* position in the archive and bounded by their total size. Entries     */
+/* still being read are in the cache too, so concurrent requests share  */
+/* the pending task; they count against the budget once they're done.   */
+/* Failed reads are dropped so the next request tries again.            */
+/************************************************************************/
+class runtime::doo::zip::ContentCache : public std::enable_shared_from_this<ContentCache> {
+public:
+  explicit ContentCache(const std::shared_ptr<StatisticsCollector>& statistics) : 
+    statistics(statistics), capacity(0), size(0), reads(0) {
+  }
+
+  uint64 Capacity() {
+    concurrency::critical_section::scoped_lock lock(cacheLock);
+    return capacity;
+  }
+
+  void SetCapacity(uint64 value) {
+    concurrency::critical_section::scoped_lock lock(cacheLock);
+    capacity = value;
+    Trim();
+  }
+
+  // the contents of the entry if they have been read completely
+  bool TryGet(unsigned int entryIndex, IBuffer^* contents) {
+    concurrency::critical_section::scoped_lock lock(cacheLock);
+    auto cached = items.find(entryIndex);
+    if (cached == items.end() || !cached->second.done) {
+      return false;
+    }
+    statistics->Totals().AddCacheHit();
+    recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, cached->second.position);
+    *contents = cached->second.contents.get();
+    return true;
+  }
+
+  /************************************************************************/
+  /* The cached or pending contents of the entry, or the task returned by */
+  /* readContents. A new read is only started, and its continuation only  */
+  /* attached, once the lock is released: the continuation takes the lock */
+  /* itself and runs inline if the read has completed already. Requests   */
+  /* coming in meanwhile wait on the pending item's completion event.     */
+  /************************************************************************/
+  concurrency::task<IBuffer^> GetAsync(unsigned int entryIndex, 
+                                       const std::function<concurrency::task<IBuffer^>()>& readContents) {
+    concurrency::task_completion_event<IBuffer^> readDone;
+    concurrency::task<IBuffer^> pending;
+    bool caching = false;
+    uint64 read = 0;
+    {
+      concurrency::critical_section::scoped_lock lock(cacheLock);
+      if (capacity != 0) {
+        auto cached = items.find(entryIndex);
+        if (cached != items.end()) {
+          statistics->Totals().AddCacheHit();
+          recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, cached->second.position);
+          return cached->second.contents;
+        }
+        statistics->Totals().AddCacheMiss();
+
+        Item item;
+        item.contents = concurrency::task<IBuffer^>(readDone);
+        item.size = 0;
+        item.done = false;
+        item.read = ++reads;
+        recentlyUsed.push_front(entryIndex);
+        item.position = recentlyUsed.begin();
+        items.insert(std::make_pair(entryIndex, item));
+        pending = item.contents;
+        read = item.read;
+        caching = true;
+      }
+    }
+    if (!caching) {
+      return readContents();
+    }
+
+    std::weak_ptr<ContentCache> cache = shared_from_this();
+    concurrency::task<IBuffer^> contents;
+    try {
+      contents = readContents();
+    } catch (...) {
+      ReadCompleted(entryIndex, read, nullptr);
+      readDone.set_exception(std::current_exception());
+      throw;
+    }
+    contents.then([cache, entryIndex, read, readDone](concurrency::task<IBuffer^> completed) {
+      IBuffer^ buffer = nullptr;
+      try {
+        buffer = completed.get();
+      } catch (...) {
+        if (auto self = cache.lock()) {
+          self->ReadCompleted(entryIndex, read, nullptr);
+        }
+        readDone.set_exception(std::current_exception());
+        return;
+      }
+      if (auto self = cache.lock()) {
+        self->ReadCompleted(entryIndex, read, buffer);
+      }
+      readDone.set(buffer);
+    }, concurrency::task_continuation_context::use_arbitrary());
+    return pending;
+  }
+
+private:
+  struct Item {
+    concurrency::task<IBuffer^> contents;
+    uint64 size;
+    bool done;
+    // tells a read apart from later reads of the same entry
+    uint64 read;
+    std::list<unsigned int>::iterator position;
+  };
+
+  void ReadCompleted(unsigned int entryIndex, uint64 read, IBuffer^ buffer) {
+    concurrency::critical_section::scoped_lock lock(cacheLock);
+    auto cached = items.find(entryIndex);
+    // the entry may have been dropped and read again in the meantime
+    if (cached == items.end() || cached->second.read != read) {
+      return;
+    }
+    if (buffer == nullptr) {
+      Remove(cached);
+      return;
+    }
+    cached->second.size = buffer->Length;
+    cached->second.done = true;
+    size += buffer->Length;
+    Trim();
+  }
+
+  // drop the least recently used entries until the cache fits its capacity,
+  // pending reads stay
+  void Trim() {
+    auto position = recentlyUsed.end();
+    while (size > capacity && position != recentlyUsed.begin()) {
+      --position;
+      auto cached = items.find(*position);
+      if (cached->second.done) {
+        position = Remove(cached);
+      }
+    }
+    if (capacity == 0) {
+      items.clear();
+      recentlyUsed.clear();
+    }
+  }
+
+  std::list<unsigned int>::iterator Remove(std::unordered_map<unsigned int, Item>::iterator cached) {
+    size -= cached->second.size;
+    auto next = recentlyUsed.erase(cached->second.position);
+    items.erase(cached);
+    return next;
+  }
+
+  std::shared_ptr<StatisticsCollector> statistics;
+  concurrency::critical_section cacheLock;
+  uint64 capacity;
+  uint64 size;
+  uint64 reads;
+  // most recently used first
+  std::list<unsigned int> recentlyUsed;
+  std::unordered_map<unsigned int, Item> items;
+};
+
 /************************************************************************/
 /* Get the uncompressed file contents as an IBuffer                     */
 /************************************************************************/
 IAsyncOperation<IBuffer^>^ ZipArchive::GetFileContentsAsync(String^ filename) {
   return concurrency::create_async([=]() -> IBuffer^ {
-    for (unsigned int i = 0; i < archiveEntries->Length; i++) {
-      if (wcscmp(archiveEntries[i]->Filename->Data(), filename->Data()) == 0) {
-        if (concurrency::is_task_cancellation_requested()) {
+    unsigned int index;
+    if (!FindEntryIndex(filename, &index)) {
+      return nullptr;
+    }
+    if (concurrency::is_task_cancellation_requested()) {
+      concurrency::cancel_current_task();
+    }
+    ZipArchiveEntry^ entry = GetEntry(index);
+    IRandomAccessStream^ stream = randomAccessStream;
+    concurrency::task<IBuffer^> uncompressTask = contentCache->GetAsync(index, [entry, stream]() {
+      return concurrency::task<IBuffer^>(entry->GetUncompressedFileContents(stream));
+    });
+    return uncompressTask.get();
+  });
+}
+
+// progress is reported whenever this many more bytes are done
+#define PROGRESS_INTERVAL (1024 * 1024)
+
+/************************************************************************/
+/* Counts the bytes done by an operation and reports them through its   */
+/* progress_reporter, at the start, then at most every PROGRESS_INTERVAL */
+/* bytes and once more at the end. Workers can add to it concurrently.  */
+/************************************************************************/
+class ProgressTracker {
+public:
+  ProgressTracker(const concurrency::progress_reporter<ZipArchiveProgress>& reporter, uint64 total) :
+    reporter(reporter),
+    total(total),
+    done(0),
+    nextReport(0) {
+    Report(false);
+  }
+
+  void Add(uint64 bytes) {
+    if (done.fetch_add(bytes) + bytes >= nextReport.load()) {
+      Report(false);
+    }
+  }
+
+  void Finish() {
+    Report(true);
+  }
+
+  // for passing on to the reading and extracting functions
+  ProgressCallback Callback() {
+    return [this](uint64 bytes) {
+      Add(bytes);
+    };
+  }
+
+private:
+  // reports go out one at a time, so they never go backwards
+  void Report(bool final) {
+    concurrency::critical_section::scoped_lock lock(reportLock);
+    uint64 now = done.load();
+    if (!final && now < nextReport.load()) {
+      return;
+    }
+    nextReport.store(now + PROGRESS_INTERVAL);
+    ZipArchiveProgress progress;
+    progress.BytesDone = now;
+    progress.BytesTotal = total;
+    reporter.report(progress);
+  }
+
+  concurrency::progress_reporter<ZipArchiveProgress> reporter;
+  uint64 total;
+  std::atomic<uint64> done;
+  std::atomic<uint64> nextReport;
+  concurrency::critical_section reportLock;
+};
+
+Windows::Foundation::IAsyncOperationWithProgress<IBuffer^, ZipArchiveProgress>^ 
+ZipArchive::GetFileContentsWithProgressAsync(String^ filename) {
+  return concurrency::create_async(
+    [=](concurrency::progress_reporter<ZipArchiveProgress> reporter, cancellation_token cancellationToken) -> IBuffer^ {
+    unsigned int index;
+    if (!FindEntryIndex(filename, &index)) {
+      return nullptr;
+    }
+    ZipArchiveEntry^ entry = GetEntry(index);
+    ProgressTracker progress(reporter, entry->uncompressedSize);
+    IBuffer^ contents;
+    if (!contentCache->TryGet(index, &contents)) {
+      contents = entry->ReadContents(randomAccessStream, cancellationToken, progress.Callback());
+    }
+    progress.Finish();
+    return contents;
+  });
+}
+
+// batched reads merge entries less than this apart and read at most this much at once
+#define BATCH_MAX_GAP (64 * 1024)
+#define BATCH_MAX_READ (8 * 1024 * 1024)
+
+/************************************************************************/
+/* The local header offset following offset in the archive, the size   */
+/* of the archive if there is none. An entry's data can't extend past   */
+/* the next entry's local header.                                       */
+/************************************************************************/
+uint64 ZipArchive::NextLocalHeaderOffset(uint64 offset) {
+  concurrency::critical_section::scoped_lock lock(localHeaderOffsetsLock);
+  if (localHeaderOffsets.empty()) {
+    localHeaderOffsets.reserve(entryTable.Count());
+    for (size_t i = 0; i < entryTable.Count(); i++) {
+      localHeaderOffsets.push_back(entryTable.LocalHeaderOffset(i));
+    }
+    std::sort(localHeaderOffsets.begin(), localHeaderOffsets.end());
+  }
+  auto next = std::upper_bound(localHeaderOffsets.begin(), localHeaderOffsets.end(), offset);
+  return next != localHeaderOffsets.end() ? *next : randomAccessStream->Size;
+}
+
+/************************************************************************/
+/* Read several files with as few requests to the stream as possible.   */
+/* The entries are sorted by their position in the archive, and the     */
+/* spans from their local headers to the next local header are merged   */
+/* into reads of up to BATCH_MAX_READ. Each read is inflated on the     */
+/* thread pool while the next one is loaded. Entries too large to batch */
+/* are read on their own.                                               */
+/************************************************************************/
+IAsyncOperation<Windows::Foundation::Collections::IVectorView<IBuffer^>^>^ 
+ZipArchive::GetFilesContentsAsync(Windows::Foundation::Collections::IIterable<String^>^ filenames) {
+  return concurrency::create_async(
+    [=](cancellation_token cancellationToken) -> Windows::Foundation::Collections::IVectorView<IBuffer^>^ {
+    // every distinct entry asked for once, files that don't exist are left out
+    std::vector<bool> requestedFound;
+    std::vector<unsigned int> requestedEntries;
+    std::vector<unsigned int> entries;
+    std::unordered_map<unsigned int, size_t> slots;
+    for (auto filename = filenames->First(); filename->HasCurrent; filename->MoveNext()) {
+      unsigned int index;
+      bool found = FindEntryIndex(filename->Current, &index);
+      requestedFound.push_back(found);
+      requestedEntries.push_back(found ? index : 0);
+      if (found && slots.insert(std::make_pair(index, 0)).second) {
+        entries.push_back(index);
+      }
+    }
+    std::sort(entries.begin(), entries.end(), [this](unsigned int a, unsigned int b) {
+      return entryTable.LocalHeaderOffset(a) < entryTable.LocalHeaderOffset(b);
+    });
+    for (size_t i = 0; i < entries.size(); i++) {
+      slots[entries[i]] = i;
+    }
+
+    std::vector<IBuffer^> contents(entries.size());
+    // the batches are shared by their entries, so they only count in the totals
+    RecordedOperation batchReads(statistics);
+    concurrency::task_group inflateTasks;
+    IRandomAccessStream^ stream = randomAccessStream;
+    size_t next = 0;
+    try {
+      while (next < entries.size()) {
+        if (cancellationToken.is_canceled()) {
           concurrency::cancel_current_task();
         }
-        concurrency::task<IBuffer^> uncompressTask(archiveEntries[i]->GetUncompressedFileContents(randomAccessStream));
-        return uncompressTask.get();
+        ZipArchiveEntry^ first = GetEntry(entries[next]);
+        uint64 readStart = first->localHeaderOffset;
+        uint64 readEnd = NextLocalHeaderOffset(readStart);
+        if (readEnd - readStart > BATCH_MAX_READ) {
+          IBuffer^* slot = &contents[next];
+          inflateTasks.run([first, stream, slot]() {
+            *slot = concurrency::task<IBuffer^>(first->GetUncompressedFileContents(stream)).get();
+          });
+          next++;
+          continue;
+        }
+        size_t count = 1;
+        while (next + count < entries.size()) {
+          uint64 start = entryTable.LocalHeaderOffset(entries[next + count]);
+          uint64 end = NextLocalHeaderOffset(start);
+          if ((start > readEnd && start - readEnd > BATCH_MAX_GAP) || end - readStart > BATCH_MAX_READ) {
+            break;
+          }
+          readEnd = end;
+          count++;
+        }
+
+        uint32 readLength = static_cast<uint32>(readEnd - readStart);
+        std::shared_ptr<std::vector<byte>> data = std::make_shared<std::vector<byte>>(readLength);
+        readBytesFromStream(stream, readStart, readLength, data->data(), data->size(), &batchReads.counters);
+        for (size_t i = next; i < next + count; i++) {
+          ZipArchiveEntry^ entry = GetEntry(entries[i]);
+          IBuffer^* slot = &contents[i];
+          inflateTasks.run([entry, stream, slot, data, readStart, readEnd]() {
+            const byte* header = data->data() + (entry->localHeaderOffset - readStart);
+            uint64 contentStart = entry->ResolveContentStreamStart(
+              header, static_cast<size_t>(readEnd - entry->localHeaderOffset));
+            if (contentStart + entry->compressedSize > readEnd) {
+              // the data doesn't end before the next local header, read it on its own
+              *slot = concurrency::task<IBuffer^>(entry->GetUncompressedFileContents(stream)).get();
+            } else {
+              RecordedOperation operation(entry->statistics, entry->filename, ZipArchiveEntryOperation::ReadContents);
+              *slot = entry->UncompressedFromMemory(data->data() + (contentStart - readStart), &operation.counters);
+            }
+          });
+        }
+        next += count;
       }
+    } catch (...) {
+      // let the running tasks finish before their data goes away
+      try { inflateTasks.wait(); } catch (...) {}
+      throw;
     }
-    return nullptr;
+    inflateTasks.wait();
+
+    auto result = ref new Platform::Collections::Vector<IBuffer^>();
+    for (size_t i = 0; i < requestedFound.size(); i++) {
+      result->Append(requestedFound[i] ? contents[slots[requestedEntries[i]]] : nullptr);
+    }
+    return result->GetView();
   });
 }
 
-concurrency::task<IStorageFile^> ZipArchive::CreateFileInFolderAsync(
-  IStorageFolder^ parent, const std::wstring& filename) {
+uint64 ZipArchive::CacheSize::get() {
+  return contentCache->Capacity();
+}
 
-  std::wstring currentFilename = filename;
-  concurrency::task<IStorageFolder^> antecedent = concurrency::create_task([parent]() {
-    return parent;
+void ZipArchive::CacheSize::set(uint64 value) {
+  contentCache->SetCapacity(value);
+}
+
+ZipArchiveStatistics^ ZipArchive::GetStatistics() {
+  return ref new ZipArchiveStatistics(statistics->Totals().Snapshot());
+}
+
+void ZipArchive::ResetStatistics() {
+  statistics->Totals().Reset();
+}
+
+ZipArchiveEntryTraceHandler^ ZipArchive::EntryTraceHandler::get() {
+  return statistics->TraceHandler();
+}
+
+void ZipArchive::EntryTraceHandler::set(ZipArchiveEntryTraceHandler^ value) {
+  statistics->SetTraceHandler(value);
+}
+
+/************************************************************************/
+/* Get part of the uncompressed file contents as an IBuffer             */
+/************************************************************************/
+IAsyncOperation<IBuffer^>^ ZipArchive::GetFileRangeAsync(String^ filename, uint64 offset, uint32 length) {
+  return concurrency::create_async([=](cancellation_token cancellationToken) -> IBuffer^ {
+    ZipArchiveEntry^ entry = FindEntry(filename);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    return entry->GetFileRange(randomAccessStream, offset, length, cancellationToken);
   });
+}
 
-  while (true) {
-    auto directorySeperatorPos = currentFilename.find(L"/");
+IAsyncOperation<IInputStream^>^ ZipArchive::OpenEntryStreamAsync(String^ filename) {
+  return OpenEntryStreamAsync(filename, INFLATE_CHUNK_SIZE);
+}
 
-    if (directorySeperatorPos == std::wstring::npos) {
-      return antecedent.then([currentFilename](IStorageFolder^ parent) {
-        return reinterpret_cast<IAsyncOperation<IStorageFile^>^>(parent->CreateFileAsync(ref new Platform::String(currentFilename.c_str()),
-          Windows::Storage::CreationCollisionOption::ReplaceExisting));
-      }, concurrency::task_continuation_context::use_arbitrary());
-    } else {
-      auto dirname = currentFilename.substr(0, directorySeperatorPos);
-      currentFilename = currentFilename.substr(directorySeperatorPos+1, std::wstring::npos);
-      antecedent = antecedent.then([dirname](IStorageFolder^ parent) {
-        return reinterpret_cast<IAsyncOperation<IStorageFolder^>^>(parent->CreateFolderAsync(ref new Platform::String(dirname.c_str()), 
-          Windows::Storage::CreationCollisionOption::OpenIfExists));
-      }, concurrency::task_continuation_context::use_arbitrary());
-      
+IAsyncOperation<IInputStream^>^ ZipArchive::OpenEntryStreamAsync(String^ filename, uint32 readaheadSize) {
+  if (readaheadSize == 0) {
+    throw ref new Platform::InvalidArgumentException(L"Readahead size must not be 0");
+  }
+  return concurrency::create_async([=]() -> IInputStream^ {
+    ZipArchiveEntry^ entry = FindEntry(filename);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    uint16 compressionMethod = entry->centralDirectoryRecord.compressionMethod;
+    if (compressionMethod != 0 && compressionMethod != 8) {
+      throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
+        compressionMethod);
+    }
+    RecordedOperation resolve(statistics);
+    IInputStream^ contents = randomAccessStream->GetInputStreamAt(
+      entry->ResolveContentStreamStart(randomAccessStream, &resolve.counters));
+    return ref new ZipEntryInputStream(entry, contents, readaheadSize);
+  });
+}
+
+IBuffer^ ZipArchive::SaveCheckpointIndex(String^ filename) {
+  ZipArchiveEntry^ entry = FindEntry(filename);
+  return entry != nullptr ? entry->SaveCheckpointIndex() : nullptr;
+}
+
+void ZipArchive::LoadCheckpointIndex(String^ filename, IBuffer^ index) {
+  ZipArchiveEntry^ entry = FindEntry(filename);
+  if (entry == nullptr) {
+    throw ref new Platform::InvalidArgumentException(L"File not found in archive: " + filename);
+  }
+  entry->LoadCheckpointIndex(index);
+}
+
+void ZipArchive::CheckpointSpacing::set(uint64 value) {
+  // entries created later pick it up from the archive
+  concurrency::critical_section::scoped_lock lock(entryObjectsLock);
+  checkpointSpacing = value;
+  if (entryObjects != nullptr) {
+    for (unsigned int i = 0; i < entryObjects->Length; i++) {
+      if (entryObjects[i] != nullptr) {
+        entryObjects[i]->SetCheckpointSpacing(value);
+      }
     }
   }
 }
+
+/************************************************************************/
+/* Folders created or opened while extracting into a destination,       */
+/* keyed by their path relative to it. Every folder is requested from   */
+/* the file system once, all later files in it reuse the pending or     */
+/* completed task. Safe to use from several workers at once.            */
+/************************************************************************/
+class runtime::doo::zip::FolderCache {
+public:
+  FolderCache(IStorageFolder^ root) :
+    rootFolder(concurrency::create_task([root]() {
+      return root;
+    })) {
+  }
+
+  concurrency::task<IStorageFolder^> GetFolderAsync(const std::wstring& path) {
+    concurrency::critical_section::scoped_lock lock(cacheLock);
+    return GetFolderLocked(path);
+  }
+
+private:
+  concurrency::task<IStorageFolder^> GetFolderLocked(const std::wstring& path) {
+    if (path.empty()) {
+      return rootFolder;
+    }
+    auto cachedFolder = folders.find(path);
+    if (cachedFolder != folders.end()) {
+      return cachedFolder->second;
+    }
+
+    auto directorySeperatorPos = path.rfind(L'/');
+    std::wstring dirname = path;
+    concurrency::task<IStorageFolder^> parentFolder = rootFolder;
+    if (directorySeperatorPos != std::wstring::npos) {
+      dirname = path.substr(directorySeperatorPos+1);
+      parentFolder = GetFolderLocked(path.substr(0, directorySeperatorPos));
+    }
+    auto folder = parentFolder.then([dirname](IStorageFolder^ parent) {
+      return reinterpret_cast<IAsyncOperation<IStorageFolder^>^>(parent->CreateFolderAsync(ref new Platform::String(dirname.c_str()), 
+        Windows::Storage::CreationCollisionOption::OpenIfExists));
+    }, concurrency::task_continuation_context::use_arbitrary());
+    folders.insert(std::make_pair(path, folder));
+    return folder;
+  }
+
+  concurrency::critical_section cacheLock;
+  concurrency::task<IStorageFolder^> rootFolder;
+  std::unordered_map<std::wstring, concurrency::task<IStorageFolder^>> folders;
+};
+
+concurrency::task<IStorageFile^> ZipArchive::CreateFileInFolderAsync(
+  const std::shared_ptr<FolderCache>& folders, const std::wstring& filename) {
+  auto directorySeperatorPos = filename.rfind(L'/');
+  std::wstring folderPath;
+  std::wstring currentFilename = filename;
+  if (directorySeperatorPos != std::wstring::npos) {
+    folderPath = filename.substr(0, directorySeperatorPos);
+    currentFilename = filename.substr(directorySeperatorPos+1);
+  }
+  return folders->GetFolderAsync(folderPath).then([currentFilename](IStorageFolder^ parent) {
+    return reinterpret_cast<IAsyncOperation<IStorageFile^>^>(parent->CreateFileAsync(ref new Platform::String(currentFilename.c_str()),
+      Windows::Storage::CreationCollisionOption::ReplaceExisting));
+  }, concurrency::task_continuation_context::use_arbitrary());
+}
+
+/************************************************************************/
+/* Extract all files using a fixed number of workers, one per core, so  */
+/* the number of open files and concurrent reads stays bounded. The     */
+/* workers take entries from a shared queue sorted by size, largest     */
+/* first, so a big file starts early instead of becoming the long tail. */
+/************************************************************************/
 IAsyncAction^ ZipArchive::ExtractAllAsync(IStorageFolder^ destination) {
-  return concurrency::create_async([this, destination]() -> concurrency::task<void> {
-    std::vector<concurrency::task<void>> copyOperations;
-    for (unsigned int i = 0; i < archiveEntries->Length; i++) {
-      std::wstring filename = archiveEntries[i]->Filename->Data();
-      if (filename[filename.length()-1] != '/') {
-        auto extractTask = CreateFileInFolderAsync(destination, filename).then([this, i](IStorageFile^ file) {
-          return archiveEntries[i]->ExtractAsync(randomAccessStream, file);
+  return concurrency::create_async([this, destination](cancellation_token cancellationToken) {
+    ExtractAllInParallel(destination, cancellationToken, nullptr);
+  });
+}
+
+void ZipArchive::ExtractAllInParallel(IStorageFolder^ destination, 
+                                      const cancellation_token& cancellationToken,
+                                      const ProgressCallback& reportProgress) {
+  std::vector<ZipArchiveEntry^> pendingEntries;
+  for (unsigned int i = 0; i < entryTable.Count(); i++) {
+    if (!entryTable.IsDirectory(i)) {
+      pendingEntries.push_back(GetEntry(i));
+    }
+  }
+  std::stable_sort(pendingEntries.begin(), pendingEntries.end(), 
+    [](ZipArchiveEntry^ a, ZipArchiveEntry^ b) {
+      return a->UncompressedSize > b->UncompressedSize;
+  });
+
+  auto folders = std::make_shared<FolderCache>(destination);
+  size_t workerCount = min((size_t)concurrency::GetProcessorCount(), pendingEntries.size());
+  std::atomic<size_t> nextEntry(0);
+  concurrency::parallel_for((size_t)0, workerCount, [&](size_t) {
+    for (size_t position = nextEntry++; position < pendingEntries.size(); position = nextEntry++) {
+      if (cancellationToken.is_canceled()) {
+        concurrency::cancel_current_task();
+      }
+      ZipArchiveEntry^ entry = pendingEntries[position];
+      IStorageFile^ file = CreateFileInFolderAsync(folders, entry->Filename->Data()).get();
+      entry->ExtractToFile(randomAccessStream, file, cancellationToken, reportProgress);
+    }
+  });
+}
+
+// sequential extraction reads chunks of this size, entries up to
+// SEQUENTIAL_ENTRY_LIMIT are inflated from memory on the thread pool
+// while at most SEQUENTIAL_MAX_BUFFERED bytes are held for them
+#define SEQUENTIAL_CHUNK_SIZE (4 * 1024 * 1024)
+#define SEQUENTIAL_ENTRY_LIMIT (16 * 1024 * 1024)
+#define SEQUENTIAL_MAX_BUFFERED (64 * 1024 * 1024)
+
+/************************************************************************/
+/* A forward-only cursor over a range of the archive, read front to     */
+/* back in chunks of SEQUENTIAL_CHUNK_SIZE with the next chunk loading  */
+/* while the current one is used.                                       */
+/************************************************************************/
+class runtime::doo::zip::SequentialStreamReader {
+public:
+  SequentialStreamReader(IRandomAccessStream^ stream, uint64 start, uint64 length, 
+                         core::StatisticsCounters* counters) :
+    reader(stream->GetInputStreamAt(start), length, counters, SEQUENTIAL_CHUNK_SIZE),
+    position(start),
+    data(nullptr),
+    available(0) {
+  }
+
+  uint64 Position() const {
+    return position;
+  }
+
+  // the next bytes up to maxLength, valid until the next call
+  const byte* Next(uint64 maxLength, uint32* length) {
+    if (available == 0) {
+      if (!reader.HasMoreData()) {
+        throw ref new Platform::FailureException(L"Unexpected end of ZIP file");
+      }
+      data = reader.NextChunk(&available);
+    }
+    *length = static_cast<uint32>(min((uint64)available, maxLength));
+    const byte* result = data;
+    data += *length;
+    available -= *length;
+    position += *length;
+    return result;
+  }
+
+  void Read(byte* destination, uint64 length) {
+    while (length > 0) {
+      uint32 read;
+      const byte* source = Next(length, &read);
+      if (destination != nullptr) {
+        memcpy(destination, source, read);
+        destination += read;
+      }
+      length -= read;
+    }
+  }
+
+  void Skip(uint64 length) {
+    Read(nullptr, length);
+  }
+
+private:
+  ChunkedStreamReader reader;
+  uint64 position;
+  const byte* data;
+  uint32 available;
+};
+
+// Bytes held by entries waiting to be inflated. Acquire() blocks while
+// taking more would go over the limit, unless nothing is held at all.
+class BufferBudget {
+public:
+  explicit BufferBudget(uint64 limit) : limit(limit), used(0) {
+  }
+
+  void Acquire(uint64 length) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (used > 0 && used + length > limit) {
+      released.wait(guard);
+    }
+    used += length;
+  }
+
+  void Release(uint64 length) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      used -= length;
+    }
+    released.notify_all();
+  }
+
+private:
+  std::mutex lock;
+  std::condition_variable released;
+  uint64 limit;
+  uint64 used;
+};
+
+/************************************************************************/
+/* Extract all files in a single pass over the archive. The entries are */
+/* visited in the order of their local headers; small ones are read     */
+/* into memory and inflated on the thread pool, large ones are inflated */
+/* by the reading thread as their data streams in. Entries that overlap */
+/* the one before can't be reached going forward and are extracted at   */
+/* random access afterwards.                                            */
+/************************************************************************/
+void ZipArchive::ExtractAllSequentially(IStorageFolder^ destination, 
+                                        const cancellation_token& cancellationToken,
+                                        const ProgressCallback& reportProgress) {
+  std::vector<ZipArchiveEntry^> pendingEntries;
+  for (unsigned int i = 0; i < entryTable.Count(); i++) {
+    if (!entryTable.IsDirectory(i)) {
+      pendingEntries.push_back(GetEntry(i));
+    }
+  }
+  if (pendingEntries.empty()) {
+    return;
+  }
+  std::stable_sort(pendingEntries.begin(), pendingEntries.end(), 
+    [](ZipArchiveEntry^ a, ZipArchiveEntry^ b) {
+      return a->localHeaderOffset < b->localHeaderOffset;
+  });
+
+  auto folders = std::make_shared<FolderCache>(destination);
+  uint64 start = pendingEntries.front()->localHeaderOffset;
+  // the last entry's data ends before the next local header or the end of the archive
+  uint64 end = NextLocalHeaderOffset(pendingEntries.back()->localHeaderOffset);
+  // the pass is shared by all entries, so its reads only count in the totals
+  RecordedOperation pass(statistics);
+  SequentialStreamReader reader(randomAccessStream, start, end > start ? end - start : 0, &pass.counters);
+  auto budget = std::make_shared<BufferBudget>(SEQUENTIAL_MAX_BUFFERED);
+  concurrency::task_group extractTasks;
+  std::vector<ZipArchiveEntry^> outOfOrder;
+  try {
+    for (size_t i = 0; i < pendingEntries.size(); i++) {
+      if (cancellationToken.is_canceled()) {
+        concurrency::cancel_current_task();
+      }
+      ZipArchiveEntry^ entry = pendingEntries[i];
+      if (entry->localHeaderOffset < reader.Position()) {
+        outOfOrder.push_back(entry);
+        continue;
+      }
+      reader.Skip(entry->localHeaderOffset - reader.Position());
+
+      // local header, filename and extra field
+      std::vector<byte> header(sizeof(core::LocalFileHeader));
+      reader.Read(header.data(), header.size());
+      core::LocalFileHeader localHeader;
+      if (!core::readLocalHeader(header.data(), header.size(), &localHeader)) {
+        throw ref new Platform::FailureException(L"Invalid local header: " + entry->filename);
+      }
+      header.resize(header.size() + localHeader.filenameLength + localHeader.extraFieldLength);
+      reader.Read(header.data() + sizeof(core::LocalFileHeader), 
+        localHeader.filenameLength + localHeader.extraFieldLength);
+      uint64 contentStart = entry->ResolveContentStreamStart(header.data(), header.size());
+      if (contentStart < reader.Position()) {
+        throw ref new Platform::FailureException(L"Invalid local header: " + entry->filename);
+      }
+      reader.Skip(contentStart - reader.Position());
+
+      if (entry->compressedSize <= SEQUENTIAL_ENTRY_LIMIT && entry->uncompressedSize <= SEQUENTIAL_ENTRY_LIMIT) {
+        uint64 held = entry->compressedSize + entry->uncompressedSize;
+        budget->Acquire(held);
+        std::shared_ptr<std::vector<byte>> data;
+        try {
+          data = std::make_shared<std::vector<byte>>(static_cast<size_t>(entry->compressedSize));
+          reader.Read(data->data(), data->size());
+        } catch (...) {
+          budget->Release(held);
+          throw;
+        }
+        extractTasks.run([this, entry, data, folders, budget, held, &reportProgress]() {
+          try {
+            RecordedOperation operation(entry->statistics, entry->filename, ZipArchiveEntryOperation::Extract);
+            IBuffer^ contents = entry->UncompressedFromMemory(data->data(), &operation.counters);
+            auto out = openFileForWriting(CreateFileInFolderAsync(folders, entry->filename->Data()).get());
+            writeToFile(out.get(), getBufferData(contents), contents->Length, entry->filename, &operation.counters);
+            if (reportProgress) {
+              reportProgress(contents->Length);
+            }
+          } catch (...) {
+            budget->Release(held);
+            throw;
+          }
+          budget->Release(held);
         });
-        copyOperations.push_back(extractTask);
+      } else {
+        auto out = openFileForWriting(CreateFileInFolderAsync(folders, entry->filename->Data()).get());
+        ExtractFromSequentialStream(entry, reader, out.get(), cancellationToken, reportProgress);
       }
     }
-    return concurrency::when_all(copyOperations.begin(), copyOperations.end());
+  } catch (...) {
+    // let the running tasks finish before the reader goes away
+    try { extractTasks.wait(); } catch (...) {}
+    throw;
+  }
+  extractTasks.wait();
+
+  for (size_t i = 0; i < outOfOrder.size(); i++) {
+    IStorageFile^ file = CreateFileInFolderAsync(folders, outOfOrder[i]->filename->Data()).get();
+    outOfOrder[i]->ExtractToFile(randomAccessStream, file, cancellationToken, reportProgress);
+  }
+}
+
+// inflate or copy the entry's data, which starts at the reader's position, to out
+void ZipArchive::ExtractFromSequentialStream(ZipArchiveEntry^ entry,
+                                             SequentialStreamReader& reader,
+                                             FILE* out,
+                                             const cancellation_token& cancellationToken,
+                                             const ProgressCallback& reportProgress) {
+  // reads are counted by the reader, for the whole pass
+  RecordedOperation operation(statistics, entry->filename, ZipArchiveEntryOperation::Extract);
+  uint64 remaining = entry->compressedSize;
+  core::StatisticsCounters* counters = &operation.counters;
+  auto writeOutput = [entry, out, counters, &reportProgress](const byte* data, size_t length) {
+    writeToFile(out, data, length, entry->filename, counters);
+    if (reportProgress) {
+      reportProgress(length);
+    }
+  };
+
+  switch (entry->centralDirectoryRecord.compressionMethod) {
+  case 0: { // file is uncompressed
+    uint32 crc = 0;
+    while (remaining > 0) {
+      if (cancellationToken.is_canceled()) {
+        concurrency::cancel_current_task();
+      }
+      uint32 length;
+      const byte* data = reader.Next(remaining, &length);
+      crc = core::updateCrc32(crc, data, length);
+      writeOutput(data, length);
+      remaining -= length;
+    }
+    entry->CheckCrc32(crc);
+    break;
+  }
+  case 8: { // deflate
+    core::PooledInflater inflater = core::acquireInflater();
+    const byte* input = nullptr;
+    uint32 inputAvailable = 0;
+    tinfl_status status;
+    do {
+      if (cancellationToken.is_canceled()) {
+        concurrency::cancel_current_task();
+      }
+      if (inputAvailable == 0 && remaining > 0) {
+        input = reader.Next(remaining, &inputAvailable);
+        remaining -= inputAvailable;
+      }
+      size_t inputSize = inputAvailable;
+      const byte* output;
+      size_t outputSize;
+      {
+        core::ScopedTimer inflating(&counters->inflateTime);
+        status = inflater->Inflate(input, &inputSize, remaining > 0, &output, &outputSize);
+      }
+      counters->bytesInflated += outputSize;
+      input += inputSize;
+      inputAvailable -= static_cast<uint32>(inputSize);
+      if (outputSize > 0) {
+        writeOutput(output, outputSize);
+      }
+    } while ((status == TINFL_STATUS_HAS_MORE_OUTPUT && inflater->TotalOut() < entry->uncompressedSize) || 
+             (status == TINFL_STATUS_NEEDS_MORE_INPUT && remaining > 0));
+    if (status != TINFL_STATUS_DONE || inflater->TotalOut() != entry->uncompressedSize) {
+      throw ref new Platform::FailureException(L"Could not extract data for file " + entry->filename);
+    }
+    entry->CheckCrc32(inflater->Crc32());
+    break;
+  }
+  default:
+    throw ref new Platform::FailureException(L"Compression algorithm not supported: " + 
+      entry->centralDirectoryRecord.compressionMethod);
+  }
+}
+
+IAsyncAction^ ZipArchive::ExtractAllAsync(IStorageFolder^ destination, ZipArchiveExtractMode extractMode) {
+  if (extractMode == ZipArchiveExtractMode::ParallelEntries) {
+    return ExtractAllAsync(destination);
+  }
+  return concurrency::create_async([this, destination](cancellation_token cancellationToken) {
+    ExtractAllSequentially(destination, cancellationToken, nullptr);
   });
 }
 
-IAsyncAction^ ZipArchive::ExtractFileAsync(Platform::String^ filename, IStorageFile^ destination) {
-  const wchar_t* fileToExtract = filename->Data();
-  for (unsigned int i = 0; i < archiveEntries->Length; i++) {
-    const wchar_t* currentFilename = archiveEntries[i]->Filename->Data();
-    if (wcscmp(fileToExtract, currentFilename) == 0) {
-      return archiveEntries[i]->ExtractAsync(randomAccessStream, destination);
+// uncompressed size of all files, without the folders
+uint64 ZipArchive::TotalFileSize() {
+  uint64 total = 0;
+  for (size_t i = 0; i < entryTable.Count(); i++) {
+    if (!entryTable.IsDirectory(i)) {
+      total += entryTable.UncompressedSize(i);
+    }
+  }
+  return total;
+}
+
+Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ 
+ZipArchive::ExtractAllWithProgressAsync(IStorageFolder^ destination) {
+  return ExtractAllWithProgressAsync(destination, ZipArchiveExtractMode::ParallelEntries);
+}
+
+Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ 
+ZipArchive::ExtractAllWithProgressAsync(IStorageFolder^ destination, ZipArchiveExtractMode extractMode) {
+  return concurrency::create_async(
+    [this, destination, extractMode](concurrency::progress_reporter<ZipArchiveProgress> reporter, 
+                                     cancellation_token cancellationToken) {
+    ProgressTracker progress(reporter, TotalFileSize());
+    if (extractMode == ZipArchiveExtractMode::SequentialRead) {
+      ExtractAllSequentially(destination, cancellationToken, progress.Callback());
+    } else {
+      ExtractAllInParallel(destination, cancellationToken, progress.Callback());
+    }
+    progress.Finish();
+  });
+}
+
+Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ 
+ZipArchive::ExtractFileWithProgressAsync(String^ filename, IStorageFile^ destination) {
+  return concurrency::create_async(
+    [this, filename, destination](concurrency::progress_reporter<ZipArchiveProgress> reporter, 
+                                  cancellation_token cancellationToken) {
+    ZipArchiveEntry^ entry = FindEntry(filename);
+    if (entry == nullptr) {
+      throw ref new Platform::InvalidArgumentException(ref new String(L"File not found: ") + filename);
     }
+    ProgressTracker progress(reporter, entry->uncompressedSize);
+    entry->ExtractToFile(randomAccessStream, destination, cancellationToken, progress.Callback());
+    progress.Finish();
+  });
+}
+
+IAsyncAction^ ZipArchive::ExtractFileAsync(Platform::String^ filename, IStorageFile^ destination) {
+  ZipArchiveEntry^ entry = FindEntry(filename);
+  if (entry != nullptr) {
+    return entry->ExtractAsync(randomAccessStream, destination);
   }
   return concurrency::create_async([filename]() {
     Platform::String^ errorMessage = ref new Platform::String(L"File not found: ") + filename;
@@ -420,7 +2385,8 @@ IAsyncAction^ ZipArchive::ExtractFileAsync(Platform::String^ filename, IStorageF
 
 IAsyncAction^ ZipArchive::ExtractFileToFolderAsync(Platform::String^ filename, IStorageFolder^ destination) {
   return concurrency::create_async([=]() {
-    return CreateFileInFolderAsync(destination, filename->Data()).then([this, &filename](IStorageFile^ file) {
+    auto folders = std::make_shared<FolderCache>(destination);
+    return CreateFileInFolderAsync(folders, filename->Data()).then([this, &filename](IStorageFile^ file) {
       return ExtractFileAsync(filename, file);
     });
   });
@@ -1,16 +1,222 @@
 ﻿#pragma once
 
 #include <collection.h>
+#include <concrt.h>
 #include <ppltasks.h>
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "directoryindex.h"
+#include "entrytable.h"
+#include "statistics.h"
+#include "zipformat.h"
+
 namespace runtime {
   namespace doo {
     namespace zip {
       typedef Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ 
         AsyncBufferOperation;
+      // called with the number of uncompressed bytes just read or extracted
+      typedef std::function<void(uint64)> ProgressCallback;
+
+      class FolderCache;
+      class SequentialStreamReader;
+      class ContentCache;
+      class StatisticsCollector;
+      ref class ZipEntryInputStream;
+      namespace core {
+        class Inflater;
+        class InflateIndex;
+      }
+
+      // how much of an archive is read and checked when it is opened
+      public enum class ZipArchiveOpenMode {
+        // read every local header and check it against the central directory
+        ValidateLocalHeaders,
+        // only parse the central directory, local headers are read and
+        // checked the first time an entry's contents are accessed
+        CentralDirectoryOnly
+      };
+
+      // how ExtractAllAsync goes through an archive
+      public enum class ZipArchiveExtractMode {
+        // one worker per core, each reading whole entries, largest first
+        ParallelEntries,
+        // read the archive front to back in large chunks and inflate the
+        // entries on the thread pool as their data arrives, for disks and
+        // streams that are much slower at random access
+        SequentialRead
+      };
+
+      // how far an operation has come, in uncompressed bytes
+      public value struct ZipArchiveProgress {
+        uint64 BytesDone;
+        uint64 BytesTotal;
+      };
+
+      // what was done with an entry, see ZipArchiveEntryTrace
+      public enum class ZipArchiveEntryOperation {
+        // GetFileContentsAsync and GetFilesContentsAsync
+        ReadContents,
+        // GetFileRangeAsync
+        ReadRange,
+        // a stream from OpenEntryStreamAsync, reported when it's closed
+        ReadStream,
+        // ExtractFileAsync, ExtractFileToFolderAsync and ExtractAllAsync
+        Extract
+      };
+
+      inline Windows::Foundation::TimeSpan nanosecondsToTimeSpan(uint64 nanoseconds) {
+        Windows::Foundation::TimeSpan timeSpan;
+        timeSpan.Duration = nanoseconds / 100;
+        return timeSpan;
+      }
+
+      // The work one operation did for one entry. Operations that failed or
+      // were canceled are reported too, with what they did up to then. Reads
+      // shared by several entries, the batches of GetFilesContentsAsync and
+      // the single pass of ExtractAllAsync, only count in ZipArchiveStatistics.
+      public ref class ZipArchiveEntryTrace sealed {
+      public:
+        property Platform::String^ Filename {
+          Platform::String^ get() {
+            return filename;
+          }
+        }
+        property ZipArchiveEntryOperation Operation {
+          ZipArchiveEntryOperation get() {
+            return operation;
+          }
+        }
+        property Windows::Foundation::TimeSpan Duration {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(duration);
+          }
+        }
+        property uint64 BytesRead {
+          uint64 get() {
+            return counters.bytesRead;
+          }
+        }
+        property uint64 ReadCount {
+          uint64 get() {
+            return counters.readCount;
+          }
+        }
+        property Windows::Foundation::TimeSpan ReadWaitTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(counters.readWaitTime);
+          }
+        }
+        property uint64 BytesInflated {
+          uint64 get() {
+            return counters.bytesInflated;
+          }
+        }
+        property Windows::Foundation::TimeSpan InflateTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(counters.inflateTime);
+          }
+        }
+        property uint64 BytesWritten {
+          uint64 get() {
+            return counters.bytesWritten;
+          }
+        }
+        property Windows::Foundation::TimeSpan WriteTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(counters.writeTime);
+          }
+        }
+
+      internal:
+        ZipArchiveEntryTrace(
+          Platform::String^ filename,
+          ZipArchiveEntryOperation operation,
+          uint64 duration,
+          const core::StatisticsCounters& counters
+          ) : filename(filename), operation(operation), duration(duration), counters(counters) {
+        }
+
+      private:
+        Platform::String^ filename;
+        ZipArchiveEntryOperation operation;
+        uint64 duration;
+        core::StatisticsCounters counters;
+      };
+
+      public delegate void ZipArchiveEntryTraceHandler(ZipArchiveEntryTrace^ trace);
+
+      // Totals of all operations on an archive. Reads are requests to the
+      // archive's stream, times are summed over all threads and can add up
+      // to more than the time that has passed.
+      public ref class ZipArchiveStatistics sealed {
+      public:
+        property uint64 BytesRead {
+          uint64 get() {
+            return totals.bytesRead;
+          }
+        }
+        property uint64 ReadCount {
+          uint64 get() {
+            return totals.readCount;
+          }
+        }
+        property Windows::Foundation::TimeSpan ReadWaitTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(totals.readWaitTime);
+          }
+        }
+        property uint64 BytesInflated {
+          uint64 get() {
+            return totals.bytesInflated;
+          }
+        }
+        property Windows::Foundation::TimeSpan InflateTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(totals.inflateTime);
+          }
+        }
+        property uint64 BytesWritten {
+          uint64 get() {
+            return totals.bytesWritten;
+          }
+        }
+        property Windows::Foundation::TimeSpan WriteTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(totals.writeTime);
+          }
+        }
+        property Windows::Foundation::TimeSpan DirectoryParseTime {
+          Windows::Foundation::TimeSpan get() {
+            return nanosecondsToTimeSpan(totals.directoryParseTime);
+          }
+        }
+        property uint64 CacheHits {
+          uint64 get() {
+            return totals.cacheHits;
+          }
+        }
+        property uint64 CacheMisses {
+          uint64 get() {
+            return totals.cacheMisses;
+          }
+        }
+
+      internal:
+        ZipArchiveStatistics(const core::StatisticsCounters& totals) : totals(totals) {
+        }
+
+      private:
+        core::StatisticsCounters totals;
+      };
 
       public ref class ZipArchiveEntry sealed {
         friend ref class ZipArchive;
+        friend ref class ZipEntryInputStream;
       public:
         property Platform::String^ Filename {
           Platform::String^ get() {
@@ -18,15 +224,15 @@ namespace runtime {
           }
         }
 
-        property uint32 CompressedSize {
-          uint32 get() {
-            return localHeader.compressedSize;
+        property uint64 CompressedSize {
+          uint64 get() {
+            return compressedSize;
           }
         }
 
-        property uint32 UncompressedSize {
-          uint32 get() {
-            return localHeader.uncompressedSize;
+        property uint64 UncompressedSize {
+          uint64 get() {
+            return uncompressedSize;
           }
         }
 
@@ -37,78 +243,126 @@ namespace runtime {
         }
 
       private:
+        // contentStreamStart is where the data starts if the local header
+        // has been checked already, 0 if not
         ZipArchiveEntry(
-          Windows::Storage::Streams::IRandomAccessStream^ centralDirectoryRecordStream
+          const core::EntryInfo& entry,
+          DWORD64 contentStreamStart,
+          const std::shared_ptr<StatisticsCollector>& statistics
           );
 
         AsyncBufferOperation GetUncompressedFileContents(
           Windows::Storage::Streams::IRandomAccessStream^ stream
           );
+        Windows::Storage::Streams::IBuffer^ ReadContents(
+          Windows::Storage::Streams::IRandomAccessStream^ stream,
+          const concurrency::cancellation_token& cancellationToken,
+          const ProgressCallback& reportProgress
+          );
+        Windows::Storage::Streams::IBuffer^ GetFileRange(
+          Windows::Storage::Streams::IRandomAccessStream^ stream,
+          uint64 offset,
+          uint32 length,
+          const concurrency::cancellation_token& cancellationToken
+          );
+
+        // totals and trace of the archive the entry belongs to
+        std::shared_ptr<StatisticsCollector> statistics;
 
         Windows::Foundation::IAsyncAction^ ExtractAsync(
           Windows::Storage::Streams::IRandomAccessStream^ stream,
           Windows::Storage::IStorageFile^ destination
           );
+        void ExtractToFile(
+          Windows::Storage::Streams::IRandomAccessStream^ stream,
+          Windows::Storage::IStorageFile^ destination,
+          const concurrency::cancellation_token& cancellationToken,
+          const ProgressCallback& reportProgress
+          );
 
-#pragma pack(1)
-        struct LocalFileHeader {
-          uint32 signature;
-          uint16 version;
-          uint16 flags;
-          uint16 compressionMethod;
-          uint16 lastModifiedTime;
-          uint16 lastModifiedDate;
-          uint32 crc32;
-          uint32 compressedSize;
-          uint32 uncompressedSize;
-          uint16 filenameLength;
-          uint16 extraFieldLength;
-        } localHeader;
-
-        struct CentralDirectoryRecord {
-          uint32 signature;
-          uint16 versionCreated;
-          uint16 versionNeeded;
-          uint16 flags;
-          uint16 compressionMethod;
-          uint16 lastModifiedTime;
-          uint16 lastModifiedDate;
-          uint32 crc32;
-          uint32 compressedSize;
-          uint32 uncompressedSize;
-          uint16 filenameLength;
-          uint16 extraFieldLength;
-          uint16 fileCommentLength;
-          uint16 diskNumberStart;
-          uint16 internalFileAttributes;
-          uint32 externalFileAttributes;
-          uint32 localHeaderOffset;
-        } centralDirectoryRecord;
-#pragma pack()
+        core::CentralDirectoryRecord centralDirectoryRecord;
 
         Platform::String^ filename;
-        Platform::String^ extraField;
+        // as stored in the archive, filename is decoded from it as UTF-8 if the
+        // entry flags it, byte by byte if not
+        std::string rawFilename;
+
+        // sizes and offset from the central directory record, replaced by
+        // the values from the ZIP64 extra field for large entries
+        uint64 compressedSize;
+        uint64 uncompressedSize;
+        uint64 localHeaderOffset;
+        void CheckCrc32(uint32 crc);
+
+        // the local header is resolved once, either on open or on first access
+        concurrency::critical_section localHeaderLock;
+        bool localHeaderChecked;
         DWORD64 contentStreamStart;
 
-        void ReadAndCheckLocalHeader(Windows::Storage::Streams::IInputStream^ stream);
+        // checkpoints into the deflated data, recorded while inflating if
+        // checkpointSpacing isn't 0 or loaded from a serialized index
+        concurrency::critical_section indexLock;
+        std::shared_ptr<core::InflateIndex> checkpointIndex;
+        bool checkpointIndexComplete;
+        uint64 checkpointSpacing;
+        std::shared_ptr<core::InflateIndex> CopyCheckpointIndex(bool forFullInflate);
+        void KeepCheckpointIndex(const std::shared_ptr<core::InflateIndex>& index, bool complete);
+        void SetCheckpointSpacing(uint64 spacing);
+        Windows::Storage::Streams::IBuffer^ SaveCheckpointIndex();
+        void LoadCheckpointIndex(Windows::Storage::Streams::IBuffer^ data);
+
+        DWORD64 ResolveContentStreamStart(
+          Windows::Storage::Streams::IRandomAccessStream^ stream,
+          core::StatisticsCounters* counters
+          );
+        // same, for a local header that has already been read into memory
+        DWORD64 ResolveContentStreamStart(const byte* data, size_t length);
+        // the entry in a directory index, and where its data starts if known
+        void AppendToDirectoryIndex(std::vector<uint8_t>* output);
+        void InflateFromStream(
+          Windows::Storage::Streams::IInputStream^ stream,
+          core::Inflater& inflater,
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters,
+          const std::function<void(const byte*, size_t)>& consumeOutput
+          );
+        Windows::Storage::Streams::IBuffer^ InflateRange(
+          Windows::Storage::Streams::IRandomAccessStream^ stream,
+          uint64 offset,
+          uint32 length,
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters
+          );
+        // the contents from the compressedSize bytes of file data at data
+        Windows::Storage::Streams::IBuffer^ UncompressedFromMemory(
+          const byte* data,
+          core::StatisticsCounters* counters
+          );
         Windows::Storage::Streams::IBuffer^ DeflateFromStream(
           Windows::Storage::Streams::IInputStream^ stream, 
-          const concurrency::cancellation_token& cancellationToken
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters,
+          const ProgressCallback& reportProgress
           );
         void DeflateFromStreamToFile(
           Windows::Storage::Streams::IInputStream^ stream,
           FILE* out,
-          const concurrency::cancellation_token& cancellationToken
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters,
+          const ProgressCallback& reportProgress
           );
         void CopyFromStreamToFile(
           Windows::Storage::Streams::IInputStream^ stream,
           FILE* out,
-          const concurrency::cancellation_token& cancellationToken
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters,
+          const ProgressCallback& reportProgress
           );
         Windows::Storage::Streams::IBuffer^ UncompressedFromStream(
           Windows::Storage::Streams::IInputStream^ stream, 
           unsigned int maxBufSize,
-          const concurrency::cancellation_token& cancellationToken
+          const concurrency::cancellation_token& cancellationToken,
+          core::StatisticsCounters* counters
           );
       };
 
@@ -119,11 +373,76 @@ namespace runtime {
         static AsyncZipArchiveOperation CreateFromFileAsync(
           Windows::Storage::IStorageFile^ file
           );
+        static AsyncZipArchiveOperation CreateFromFileAsync(
+          Windows::Storage::IStorageFile^ file,
+          ZipArchiveOpenMode openMode
+          );
         static AsyncZipArchiveOperation CreateFromStreamReferenceAsync(
           Windows::Storage::Streams::RandomAccessStreamReference^ reference
           );
+        static AsyncZipArchiveOperation CreateFromStreamReferenceAsync(
+          Windows::Storage::Streams::RandomAccessStreamReference^ reference,
+          ZipArchiveOpenMode openMode
+          );
+        // Open the archive with the entries of a directory index returned by
+        // SaveDirectoryIndex. The index is ignored if it was saved for a
+        // different version of the archive, or if it is null. Streams have no
+        // modification time, their archives are only recognized by size and
+        // end of central directory: pass an index for a stream only if it
+        // can't have been rewritten with the same size since.
+        static AsyncZipArchiveOperation CreateFromFileAsync(
+          Windows::Storage::IStorageFile^ file,
+          ZipArchiveOpenMode openMode,
+          Windows::Storage::Streams::IBuffer^ directoryIndex
+          );
+        static AsyncZipArchiveOperation CreateFromStreamReferenceAsync(
+          Windows::Storage::Streams::RandomAccessStreamReference^ reference,
+          ZipArchiveOpenMode openMode,
+          Windows::Storage::Streams::IBuffer^ directoryIndex
+          );
+
+        // The parsed central directory and the local header positions resolved
+        // so far, keyed by the archive's size, modification time and end of
+        // central directory. Store it to open the archive faster next time.
+        Windows::Storage::Streams::IBuffer^ SaveDirectoryIndex();
+
+        // whether the entries were taken from the directory index passed on open
+        property boolean DirectoryIndexUsed {
+          boolean get() {
+            return directoryIndexUsed;
+          }
+        }
 
         AsyncBufferOperation GetFileContentsAsync(Platform::String^ filename);
+        // Same, reporting the uncompressed bytes read so far. Cancellation is
+        // checked for every chunk inflated. Files in the cache are returned
+        // from it, files read here aren't added to it.
+        Windows::Foundation::IAsyncOperationWithProgress<Windows::Storage::Streams::IBuffer^, ZipArchiveProgress>^ 
+          GetFileContentsWithProgressAsync(Platform::String^ filename);
+        // The contents of several files, in the order they are asked for and
+        // null for files that don't exist. Files close to each other in the
+        // archive are fetched with a single read and inflated in parallel.
+        Windows::Foundation::IAsyncOperation<
+          Windows::Foundation::Collections::IVectorView<Windows::Storage::Streams::IBuffer^>^>^ 
+          GetFilesContentsAsync(Windows::Foundation::Collections::IIterable<Platform::String^>^ filenames);
+        // length bytes of the uncompressed file starting at offset, fewer if
+        // the file ends before. Deflated files are inflated from the nearest
+        // checkpoint in front of offset, see CheckpointSpacing.
+        AsyncBufferOperation GetFileRangeAsync(Platform::String^ filename, uint64 offset, uint32 length);
+
+        // A forward-only stream of the uncompressed file that inflates as it
+        // is read, null if there is no such file. readaheadSize compressed
+        // bytes are requested from the archive ahead of the decompressor.
+        Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IInputStream^>^ 
+          OpenEntryStreamAsync(Platform::String^ filename);
+        Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IInputStream^>^ 
+          OpenEntryStreamAsync(Platform::String^ filename, uint32 readaheadSize);
+
+        // The checkpoint index of a deflated file in a portable format, or
+        // null if none has been recorded. Loading it into a later instance
+        // of the archive lets range reads use it right away.
+        Windows::Storage::Streams::IBuffer^ SaveCheckpointIndex(Platform::String^ filename);
+        void LoadCheckpointIndex(Platform::String^ filename, Windows::Storage::Streams::IBuffer^ index);
         Windows::Foundation::IAsyncAction^ ExtractFileAsync(
           Platform::String^ filename, 
           Windows::Storage::IStorageFile^ destination);
@@ -133,37 +452,153 @@ namespace runtime {
           );
         Windows::Foundation::IAsyncAction^ ExtractAllAsync(
           Windows::Storage::IStorageFolder^ destination);
+        Windows::Foundation::IAsyncAction^ ExtractAllAsync(
+          Windows::Storage::IStorageFolder^ destination,
+          ZipArchiveExtractMode extractMode);
 
+        // Extraction reporting the uncompressed bytes written so far out of
+        // the total size of the files
+        Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ ExtractFileWithProgressAsync(
+          Platform::String^ filename,
+          Windows::Storage::IStorageFile^ destination);
+        Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ ExtractAllWithProgressAsync(
+          Windows::Storage::IStorageFolder^ destination);
+        Windows::Foundation::IAsyncActionWithProgress<ZipArchiveProgress>^ ExtractAllWithProgressAsync(
+          Windows::Storage::IStorageFolder^ destination,
+          ZipArchiveExtractMode extractMode);
+
+        // The entries are created when they are first used, this creates
+        // all that haven't been yet
         property Platform::Array<ZipArchiveEntry^>^ Files {
-          Platform::Array<ZipArchiveEntry^>^ get() {
-            return archiveEntries;
-          };
+          Platform::Array<ZipArchiveEntry^>^ get();
+        }
+
+        // The entries in a folder, given like "word/media" with or without
+        // the trailing slash, or empty for the root. Unless recursive, only
+        // the files and folders directly in it are returned, folders only if
+        // the archive has entries for them. Ordered by filename, or by folded
+        // filename if IgnoreCase is set, and only the entries returned are
+        // created.
+        Windows::Foundation::Collections::IVectorView<ZipArchiveEntry^>^ 
+          GetEntriesInFolder(Platform::String^ folder, boolean recursive);
+        // The entries whose filenames match pattern, where * stands for any
+        // characters but /, ** for any characters, **/ for any folders or
+        // none, and ? for one character but /. Only filenames starting with
+        // the pattern's part in front of the first wildcard are looked at.
+        Windows::Foundation::Collections::IVectorView<ZipArchiveEntry^>^ 
+          FindEntries(Platform::String^ pattern);
+
+        // If set, filenames passed to the lookup methods are matched case
+        // insensitively. Folder and pattern queries return every entry that
+        // matches, lookups of a single file the first.
+        property boolean IgnoreCase {
+          boolean get() {
+            return ignoreCase;
+          }
+          void set(boolean value) {
+            ignoreCase = value;
+          }
+        }
+
+        // If not 0, inflating a deflated file records a checkpoint about every
+        // CheckpointSpacing bytes of output, each holding a 32 KB window.
+        // Range reads resume at the checkpoint in front of the range.
+        property uint64 CheckpointSpacing {
+          uint64 get() {
+            return checkpointSpacing;
+          }
+          void set(uint64 value);
+        }
+
+        // Bytes of uncompressed contents GetFileContentsAsync keeps in memory,
+        // the least recently used files are dropped first. 0, the default,
+        // turns the cache off. While caching, concurrent requests for a file
+        // share one read, and every caller gets the same buffer, which must
+        // not be modified.
+        property uint64 CacheSize {
+          uint64 get();
+          void set(uint64 value);
+        }
+
+        // Counters and timings of everything done with the archive since it
+        // was opened or since the last call to ResetStatistics
+        ZipArchiveStatistics^ GetStatistics();
+        void ResetStatistics();
+
+        // If set, called with a trace of every operation on an entry when it
+        // ends, on the thread that did the work. Exceptions thrown by the
+        // handler are ignored.
+        property ZipArchiveEntryTraceHandler^ EntryTraceHandler {
+          ZipArchiveEntryTraceHandler^ get();
+          void set(ZipArchiveEntryTraceHandler^ value);
         }
 
       private:
-#pragma pack(1)
-        struct EndOfCentralDirectoryRecord {
-          uint32 signature;
-          uint16 diskNumber;
-          uint16 directoryDiskNumber;
-          uint16 entryCountThisDisk;
-          uint16 entryCountTotal;
-          uint32 centralDirectorySize;
-          uint32 centralDirectoryOffset;
-          uint16 zipFileCommentLength;
-        } endOfCentralDirectoryRecord;
-#pragma pack()
-
-        Platform::Array<ZipArchiveEntry^>^ archiveEntries;
+        // what is known about the entries without creating their objects
+        core::EntryTable entryTable;
+        // the entry objects, null until an entry is used or Files is read
+        concurrency::critical_section entryObjectsLock;
+        Platform::Array<ZipArchiveEntry^>^ entryObjects;
+        ZipArchiveEntry^ GetEntry(unsigned int index);
+        ZipArchiveEntry^ EntryObject(unsigned int index);
+        Windows::Foundation::Collections::IVectorView<ZipArchiveEntry^>^ 
+          GetEntries(const std::vector<size_t>& indexes);
+
+        // the filenames are sorted on the first folder or pattern query
+        concurrency::critical_section sortedFilenamesLock;
+        void SortFilenames();
+
+        uint64 checkpointSpacing;
         Windows::Storage::Streams::IRandomAccessStream^ randomAccessStream;
+
+        // the folded filenames are added to the table and sorted on the first
+        // lookup or query with IgnoreCase
+        concurrency::critical_section foldedFilenamesLock;
+        void SortFoldedFilenames();
+        boolean ignoreCase;
+        ZipArchiveEntry^ FindEntry(Platform::String^ filename);
+        bool FindEntryIndex(Platform::String^ filename, unsigned int* index);
+
+        std::shared_ptr<StatisticsCollector> statistics;
+        std::shared_ptr<ContentCache> contentCache;
+
+        // local header offsets of all entries in ascending order, built by the
+        // first batched read to find where each entry's data ends at the latest
+        concurrency::critical_section localHeaderOffsetsLock;
+        std::vector<uint64> localHeaderOffsets;
+        uint64 NextLocalHeaderOffset(uint64 offset);
+
+        core::ArchiveFingerprint fingerprint;
+        boolean directoryIndexUsed;
+        bool ReadDirectoryIndex(Windows::Storage::Streams::IBuffer^ directoryIndex);
+
+        uint64 TotalFileSize();
+        void ExtractAllInParallel(
+          Windows::Storage::IStorageFolder^ destination,
+          const concurrency::cancellation_token& cancellationToken,
+          const ProgressCallback& reportProgress);
+        void ExtractAllSequentially(
+          Windows::Storage::IStorageFolder^ destination,
+          const concurrency::cancellation_token& cancellationToken,
+          const ProgressCallback& reportProgress);
+        void ExtractFromSequentialStream(
+          ZipArchiveEntry^ entry,
+          SequentialStreamReader& reader,
+          FILE* out,
+          const concurrency::cancellation_token& cancellationToken,
+          const ProgressCallback& reportProgress);
+
         concurrency::task<Windows::Storage::IStorageFile^> 
           CreateFileInFolderAsync(
-            Windows::Storage::IStorageFolder^ parent, 
+            const std::shared_ptr<FolderCache>& folders, 
             const std::wstring& filename);
 
         ZipArchive(
           Windows::Storage::Streams::IRandomAccessStream^ stream, 
-          concurrency::cancellation_token cancellationToken
+          ZipArchiveOpenMode openMode,
+          concurrency::cancellation_token cancellationToken,
+          uint64 lastModified,
+          Windows::Storage::Streams::IBuffer^ directoryIndex
           );
       };
     }
@@ -0,0 +1,272 @@
+﻿
+#include <wrl/client.h>
+#include <robuffer.h>
+
+#include <ppltasks.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "ziparchivewriter.h"
+#include "zipwriter.h"
+
+using namespace runtime::doo::zip;
+
+using Platform::String;
+
+using Microsoft::WRL::ComPtr;
+
+using Windows::Foundation::IAsyncOperation;
+using Windows::Foundation::IAsyncAction;
+using Windows::Storage::Streams::IBuffer;
+using Windows::Storage::Streams::IBufferByteAccess;
+using Windows::Storage::Streams::IInputStream;
+using Windows::Storage::Streams::IOutputStream;
+using Windows::Storage::Streams::IRandomAccessStream;
+using Windows::Storage::IStorageFile;
+
+using concurrency::cancellation_token;
+
+// output is handed to the stream in pieces of this size
+#define WRITE_BUFFER_SIZE 1024*1024
+// size of the pieces read from streams that are added to the archive
+#define READ_CHUNK_SIZE 256*1024
+
+static byte* getBufferData(IBuffer^ buffer) {
+  ComPtr<IUnknown> comBuffer(reinterpret_cast<IUnknown*>(buffer));
+  ComPtr<IBufferByteAccess> byteBuffer;
+  comBuffer.As(&byteBuffer);
+  byte* data;
+  byteBuffer->Buffer(&data);
+  return data;
+}
+
+// filenames are stored as UTF-8 with forward slashes as separators
+static std::string filenameToUtf8(String^ filename) {
+  std::wstring wideFilename(filename->Data(), filename->Length());
+  for (size_t i = 0; i < wideFilename.length(); i++) {
+    if (wideFilename[i] == L'\\') {
+      wideFilename[i] = L'/';
+    }
+  }
+  int length = WideCharToMultiByte(CP_UTF8, 0, wideFilename.c_str(), 
+    static_cast<int>(wideFilename.length()), nullptr, 0, nullptr, nullptr);
+  std::string utf8Filename(length, '\0');
+  if (length > 0) {
+    WideCharToMultiByte(CP_UTF8, 0, wideFilename.c_str(), 
+      static_cast<int>(wideFilename.length()), &utf8Filename[0], length, nullptr, nullptr);
+  }
+  return utf8Filename;
+}
+
+// errors of the core writer are ASCII messages, passed on as Platform exceptions
+static Platform::Exception^ toPlatformException(const std::logic_error& error) {
+  const char* message = error.what();
+  std::wstring wideMessage(message, message + strlen(message));
+  return ref new Platform::FailureException(ref new String(wideMessage.c_str()));
+}
+
+/************************************************************************/
+/* Read a stream to its end in chunks and add it to the open entry       */
+/************************************************************************/
+static void writeStreamToEntry(IInputStream^ contents, 
+                               core::ZipWriter& zipWriter, 
+                               const cancellation_token& cancellationToken) {
+  auto chunk = ref new Windows::Storage::Streams::Buffer(READ_CHUNK_SIZE);
+  for (;;) {
+    if (cancellationToken.is_canceled()) {
+      concurrency::cancel_current_task();
+    }
+    concurrency::task<IBuffer^> readTask(contents->ReadAsync(chunk, READ_CHUNK_SIZE, 
+      Windows::Storage::Streams::InputStreamOptions::None));
+    IBuffer^ read = readTask.get();
+    if (read->Length == 0) {
+      break;
+    }
+    zipWriter.WriteEntryData(getBufferData(read), read->Length);
+  }
+}
+
+ZipArchiveWriter::ZipArchiveWriter(IOutputStream^ stream) :
+  outputStream(stream),
+  compressionLevel(core::DEFLATE_DEFAULT_LEVEL),
+  compressionThreadCount(1),
+  failed(false) {
+  outputBuffer.reserve(WRITE_BUFFER_SIZE);
+  writer = std::make_shared<core::ZipWriter>([this](const uint8_t* data, size_t length) {
+    WriteToStream(data, length);
+  });
+}
+
+/************************************************************************/
+/* Create an archive in a file, replacing whatever the file contained   */
+/************************************************************************/
+IAsyncOperation<ZipArchiveWriter^>^ ZipArchiveWriter::CreateForFileAsync(IStorageFile^ file) {
+  return concurrency::create_async([=]() -> ZipArchiveWriter^ {
+    auto fileOpenTask = concurrency::task<IRandomAccessStream^>(
+      file->OpenAsync(Windows::Storage::FileAccessMode::ReadWrite));
+    auto createWriterTask = fileOpenTask.then([=](IRandomAccessStream^ stream) -> ZipArchiveWriter^ {
+      stream->Size = 0;
+      return ref new ZipArchiveWriter(stream->GetOutputStreamAt(0));
+    }, concurrency::task_continuation_context::use_arbitrary());
+    return createWriterTask.get();
+  });
+}
+
+IAsyncOperation<ZipArchiveWriter^>^ ZipArchiveWriter::CreateForStreamAsync(IOutputStream^ stream) {
+  return concurrency::create_async([=]() -> ZipArchiveWriter^ {
+    return ref new ZipArchiveWriter(stream);
+  });
+}
+
+void ZipArchiveWriter::CompressionLevel::set(int value) {
+  if (value != core::ZIP_STORE_LEVEL && 
+      (value < core::DEFLATE_MIN_LEVEL || value > core::DEFLATE_MAX_LEVEL)) {
+    throw ref new Platform::InvalidArgumentException(L"Compression level must be between 0 and 9");
+  }
+  compressionLevel = value;
+}
+
+/************************************************************************/
+/* Collect the archive's output and pass it on to the stream whenever   */
+/* the buffer is full                                                   */
+/************************************************************************/
+void ZipArchiveWriter::WriteToStream(const uint8_t* data, size_t length) {
+  while (length > 0) {
+    size_t copied = min(length, (size_t)WRITE_BUFFER_SIZE - outputBuffer.size());
+    outputBuffer.insert(outputBuffer.end(), data, data + copied);
+    data += copied;
+    length -= copied;
+    if (outputBuffer.size() == WRITE_BUFFER_SIZE) {
+      FlushToStream();
+    }
+  }
+}
+
+void ZipArchiveWriter::FlushToStream() {
+  if (outputBuffer.empty()) {
+    return;
+  }
+  uint32 length = static_cast<uint32>(outputBuffer.size());
+  auto buffer = ref new Windows::Storage::Streams::Buffer(length);
+  memcpy(getBufferData(buffer), outputBuffer.data(), length);
+  buffer->Length = length;
+  concurrency::task<uint32> writeTask(outputStream->WriteAsync(buffer));
+  if (writeTask.get() != length) {
+    throw ref new Platform::FailureException(L"Could not write ZIP file");
+  }
+  outputBuffer.clear();
+}
+
+/************************************************************************/
+/* Write a whole entry while holding the lock, so entries added at the  */
+/* same time end up one after the other in the archive. Once an entry   */
+/* fails part way, its data can't be told apart from the next entry's   */
+/* and a block that failed to deflate has left a broken stream behind,  */
+/* so the archive can't be completed anymore.                           */
+/************************************************************************/
+void ZipArchiveWriter::AddFile(String^ filename, 
+                               int level, 
+                               uint32 threadCount,
+                               uint64_t expectedSize,
+                               const std::function<void(core::ZipWriter&)>& writeContents) {
+  if (filename == nullptr || filename->IsEmpty()) {
+    throw ref new Platform::InvalidArgumentException(L"Filename must not be empty");
+  }
+  std::string utf8Filename = filenameToUtf8(filename);
+  if (utf8Filename.length() > UINT16_MAX) {
+    throw ref new Platform::InvalidArgumentException(L"Filename is too long: " + filename);
+  }
+  SYSTEMTIME now;
+  GetLocalTime(&now);
+  uint16_t dosTime = static_cast<uint16_t>((now.wHour << 11) | (now.wMinute << 5) | (now.wSecond / 2));
+  uint16_t dosDate = static_cast<uint16_t>(((now.wYear - 1980) << 9) | (now.wMonth << 5) | now.wDay);
+
+  concurrency::critical_section::scoped_lock lock(writerLock);
+  if (!writer) {
+    throw ref new Platform::FailureException(L"The ZIP archive is already closed");
+  }
+  if (failed) {
+    throw ref new Platform::FailureException(L"The ZIP archive is incomplete, adding a file to it failed");
+  }
+  writer->SetCompressionThreadCount(threadCount);
+  try {
+    writer->OpenEntry(utf8Filename.data(), utf8Filename.length(), level, dosTime, dosDate, expectedSize);
+    writeContents(*writer);
+    writer->CloseEntry();
+  } catch (const std::logic_error& error) {
+    failed = true;
+    throw toPlatformException(error);
+  } catch (...) {
+    failed = true;
+    throw;
+  }
+}
+
+IAsyncAction^ ZipArchiveWriter::AddFileFromBufferAsync(String^ filename, IBuffer^ contents) {
+  int level = compressionLevel;
+  uint32 threadCount = compressionThreadCount;
+  return concurrency::create_async([=]() {
+    uint64_t size = contents != nullptr ? contents->Length : 0;
+    AddFile(filename, level, threadCount, size, [contents](core::ZipWriter& zipWriter) {
+      if (contents != nullptr) {
+        zipWriter.WriteEntryData(getBufferData(contents), contents->Length);
+      }
+    });
+  });
+}
+
+IAsyncAction^ ZipArchiveWriter::AddFileFromStreamAsync(String^ filename, IInputStream^ contents) {
+  int level = compressionLevel;
+  uint32 threadCount = compressionThreadCount;
+  return concurrency::create_async([=](cancellation_token cancellationToken) {
+    AddFile(filename, level, threadCount, core::ZIP_SIZE_UNKNOWN, 
+            [contents, cancellationToken](core::ZipWriter& zipWriter) {
+      writeStreamToEntry(contents, zipWriter, cancellationToken);
+    });
+  });
+}
+
+IAsyncAction^ ZipArchiveWriter::AddFileFromStorageFileAsync(String^ filename, IStorageFile^ file) {
+  int level = compressionLevel;
+  uint32 threadCount = compressionThreadCount;
+  return concurrency::create_async([=](cancellation_token cancellationToken) {
+    auto fileOpenTask = concurrency::task<Windows::Storage::Streams::IRandomAccessStreamWithContentType^>(
+      file->OpenReadAsync());
+    auto fileStream = fileOpenTask.get();
+    // the size is only a hint, the file may still grow while it is added
+    uint64_t size = fileStream->Size;
+    IInputStream^ contents = fileStream;
+    AddFile(filename, level, threadCount, size, [contents, cancellationToken](core::ZipWriter& zipWriter) {
+      writeStreamToEntry(contents, zipWriter, cancellationToken);
+    });
+  });
+}
+
+/************************************************************************/
+/* Finish the archive with the central directory and flush the stream   */
+/************************************************************************/
+IAsyncAction^ ZipArchiveWriter::CloseAsync() {
+  return concurrency::create_async([=]() {
+    concurrency::critical_section::scoped_lock lock(writerLock);
+    if (!writer) {
+      return;
+    }
+    if (failed) {
+      throw ref new Platform::FailureException(L"The ZIP archive is incomplete, adding a file to it failed");
+    }
+    try {
+      writer->Finish();
+      FlushToStream();
+      concurrency::task<bool> flushTask(outputStream->FlushAsync());
+      flushTask.get();
+    } catch (const std::logic_error& error) {
+      failed = true;
+      throw toPlatformException(error);
+    } catch (...) {
+      failed = true;
+      throw;
+    }
+    writer.reset();
+  });
+}
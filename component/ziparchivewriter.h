@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        class ZipWriter;
+      }
+
+      // writes a new ZIP archive entry by entry
+      public ref class ZipArchiveWriter sealed {
+        typedef Windows::Foundation::IAsyncOperation<ZipArchiveWriter^>^ AsyncZipArchiveWriterOperation;
+      public:
+        // the file is truncated, existing contents are replaced by the archive
+        static AsyncZipArchiveWriterOperation CreateForFileAsync(
+          Windows::Storage::IStorageFile^ file
+          );
+        static AsyncZipArchiveWriterOperation CreateForStreamAsync(
+          Windows::Storage::Streams::IOutputStream^ stream
+          );
+
+        // 0 stores entries uncompressed, 1 (fastest) to 9 (smallest) deflates
+        // them, applies to entries added after it is set
+        property int CompressionLevel {
+          int get() {
+            return compressionLevel;
+          }
+          void set(int value);
+        }
+
+        // 1 compresses each entry on a single thread, more split large
+        // entries into blocks deflated in parallel, 0 uses every core
+        property uint32 CompressionThreadCount {
+          uint32 get() {
+            return compressionThreadCount;
+          }
+          void set(uint32 value) {
+            compressionThreadCount = value;
+          }
+        }
+
+        // If adding a file fails or is canceled, the archive can't be
+        // completed: later adds and CloseAsync() fail as well.
+        Windows::Foundation::IAsyncAction^ AddFileFromBufferAsync(
+          Platform::String^ filename,
+          Windows::Storage::Streams::IBuffer^ contents
+          );
+        // the stream's length isn't known up front, so its entry always gets
+        // ZIP64 sizes, which some older tools can't read
+        Windows::Foundation::IAsyncAction^ AddFileFromStreamAsync(
+          Platform::String^ filename,
+          Windows::Storage::Streams::IInputStream^ contents
+          );
+        Windows::Foundation::IAsyncAction^ AddFileFromStorageFileAsync(
+          Platform::String^ filename,
+          Windows::Storage::IStorageFile^ file
+          );
+
+        // write the central directory, no entries can be added afterwards
+        Windows::Foundation::IAsyncAction^ CloseAsync();
+
+      private:
+        ZipArchiveWriter(Windows::Storage::Streams::IOutputStream^ stream);
+
+        void AddFile(
+          Platform::String^ filename,
+          int level,
+          uint32 threadCount,
+          uint64_t expectedSize,
+          const std::function<void(core::ZipWriter&)>& writeContents
+          );
+        void WriteToStream(const uint8_t* data, size_t length);
+        void FlushToStream();
+
+        Windows::Storage::Streams::IOutputStream^ outputStream;
+        std::shared_ptr<core::ZipWriter> writer;
+        // output is collected and written to the stream in large pieces
+        std::vector<uint8_t> outputBuffer;
+        int compressionLevel;
+        uint32 compressionThreadCount;
+        // set when writing failed part way, what was written can't be finished
+        bool failed;
+
+        // entries are written one after the other, concurrent adds wait here
+        concurrency::critical_section writerLock;
+      };
+    }
+  }
+}
@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "zipformat.h"
+
+using namespace runtime::doo::zip::core;
+
+/************************************************************************/
+/* The end of central directory record is the last thing in an archive, */
+/* only followed by the archive comment. Search backwards for a record  */
+/* whose comment length matches the bytes that follow it.               */
+/************************************************************************/
+bool runtime::doo::zip::core::readEndOfCentralDirectory(const uint8_t* tail,
+                                                        size_t tailLength,
+                                                        CentralDirectoryLocation* location) {
+  if (tailLength < sizeof(EndOfCentralDirectoryRecord)) {
+    return false;
+  }
+  size_t position = tailLength - sizeof(EndOfCentralDirectoryRecord);
+  for (;;) {
+    EndOfCentralDirectoryRecord record;
+    memcpy(&record, tail + position, sizeof(record));
+    if (record.signature == ZipArchive_END_OF_CENTRAL_RECORD_SIGNATURE &&
+        position + sizeof(record) + record.zipFileCommentLength == tailLength) {
+      location->entryCount = record.entryCountThisDisk;
+      location->size = record.centralDirectorySize;
+      location->offset = record.centralDirectoryOffset;
+      location->hasZip64Record = false;
+      location->zip64RecordOffset = 0;
+
+      if (position >= sizeof(Zip64EndOfCentralDirectoryLocator)) {
+        Zip64EndOfCentralDirectoryLocator locator;
+        memcpy(&locator, tail + position - sizeof(locator), sizeof(locator));
+        if (locator.signature == ZipArchive_ZIP64_END_OF_CENTRAL_LOCATOR_SIGNATURE) {
+          location->hasZip64Record = true;
+          location->zip64RecordOffset = locator.endOfCentralDirectoryOffset;
+        }
+      }
+      return true;
+    }
+    if (position == 0) {
+      return false;
+    }
+    position--;
+  }
+}
+
+bool runtime::doo::zip::core::readZip64EndOfCentralDirectory(const uint8_t* data,
+                                                             size_t length,
+                                                             CentralDirectoryLocation* location) {
+  Zip64EndOfCentralDirectoryRecord record;
+  if (length < sizeof(record)) {
+    return false;
+  }
+  memcpy(&record, data, sizeof(record));
+  if (record.signature != ZipArchive_ZIP64_END_OF_CENTRAL_RECORD_SIGNATURE) {
+    return false;
+  }
+  location->entryCount = record.entryCountThisDisk;
+  location->size = record.centralDirectorySize;
+  location->offset = record.centralDirectoryOffset;
+  return true;
+}
+
+/************************************************************************/
+/* Entries that don't fit the 32 bit fields of the central directory    */
+/* record store their real sizes and offset in the ZIP64 extended       */
+/* information extra field. Only the values that are set to 0xFFFFFFFF  */
+/* in the record are present, always in this order.                     */
+/************************************************************************/
+static bool readZip64ExtraField(const uint8_t* extraField, uint16_t length, EntryInfo* entry) {
+  const uint8_t* end = extraField + length;
+  while (end - extraField >= 4) {
+    uint16_t headerId, dataSize;
+    memcpy(&headerId, extraField, sizeof(headerId));
+    memcpy(&dataSize, extraField + 2, sizeof(dataSize));
+    extraField += 4;
+    if (end - extraField < dataSize) {
+      break;
+    }
+    if (headerId == ZipArchive_ZIP64_EXTRA_FIELD_ID) {
+      const uint8_t* value = extraField;
+      const uint8_t* valuesEnd = extraField + dataSize;
+      uint64_t* fields[] = { &entry->uncompressedSize, &entry->compressedSize, &entry->localHeaderOffset };
+      for (int i = 0; i < 3; i++) {
+        if (*fields[i] != ZipArchive_ZIP64_MARKER) {
+          continue;
+        }
+        if ((size_t)(valuesEnd - value) < sizeof(uint64_t)) {
+          return false;
+        }
+        memcpy(fields[i], value, sizeof(uint64_t));
+        value += sizeof(uint64_t);
+      }
+      return true;
+    }
+    extraField += dataSize;
+  }
+  return true;
+}
+
+bool runtime::doo::zip::core::readCentralDirectoryEntry(const uint8_t** record,
+                                                        const uint8_t* recordsEnd,
+                                                        EntryInfo* entry) {
+  const uint8_t* data = *record;
+  if ((size_t)(recordsEnd - data) < sizeof(CentralDirectoryRecord)) {
+    return false;
+  }
+  memcpy(&entry->record, data, sizeof(CentralDirectoryRecord));
+  if (entry->record.signature != ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE) {
+    return false;
+  }
+  data += sizeof(CentralDirectoryRecord);
+
+  size_t variableLength = (size_t)entry->record.filenameLength
+    + entry->record.extraFieldLength
+    + entry->record.fileCommentLength;
+  if ((size_t)(recordsEnd - data) < variableLength) {
+    return false;
+  }
+  entry->filename = reinterpret_cast<const char*>(data);
+  entry->filenameLength = entry->record.filenameLength;
+  entry->compressedSize = entry->record.compressedSize;
+  entry->uncompressedSize = entry->record.uncompressedSize;
+  entry->localHeaderOffset = entry->record.localHeaderOffset;
+  if (!readZip64ExtraField(data + entry->record.filenameLength, entry->record.extraFieldLength, entry)) {
+    return false;
+  }
+  *record = data + variableLength;
+  return true;
+}
+
+bool runtime::doo::zip::core::readLocalHeader(const uint8_t* data,
+                                              size_t length,
+                                              LocalFileHeader* header) {
+  if (length < sizeof(LocalFileHeader)) {
+    return false;
+  }
+  memcpy(header, data, sizeof(LocalFileHeader));
+  return header->signature == ZipArchive_ENTRY_LOCAL_HEADER_SIGNATURE;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the expected signatures for different parts of a ZIP file
+#define ZipArchive_ENTRY_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE 0x02014b50
+#define ZipArchive_END_OF_CENTRAL_RECORD_SIGNATURE 0x06054b50
+#define ZipArchive_ZIP64_END_OF_CENTRAL_RECORD_SIGNATURE 0x06064b50
+#define ZipArchive_ZIP64_END_OF_CENTRAL_LOCATOR_SIGNATURE 0x07064b50
+#define ZipArchive_DATA_DESCRIPTOR_SIGNATURE 0x08074b50
+
+// header id of the ZIP64 extended information extra field
+#define ZipArchive_ZIP64_EXTRA_FIELD_ID 0x0001
+// 32 bit sizes and offsets set to this value are stored in the ZIP64 extra field
+#define ZipArchive_ZIP64_MARKER 0xFFFFFFFF
+
+// general purpose flags: sizes and CRC-32 follow the data, filename is UTF-8
+#define ZipArchive_FLAG_DATA_DESCRIPTOR 0x0008
+#define ZipArchive_FLAG_UTF8 0x0800
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+#pragma pack(1)
+        struct LocalFileHeader {
+          uint32_t signature;
+          uint16_t version;
+          uint16_t flags;
+          uint16_t compressionMethod;
+          uint16_t lastModifiedTime;
+          uint16_t lastModifiedDate;
+          uint32_t crc32;
+          uint32_t compressedSize;
+          uint32_t uncompressedSize;
+          uint16_t filenameLength;
+          uint16_t extraFieldLength;
+        };
+
+        struct CentralDirectoryRecord {
+          uint32_t signature;
+          uint16_t versionCreated;
+          uint16_t versionNeeded;
+          uint16_t flags;
+          uint16_t compressionMethod;
+          uint16_t lastModifiedTime;
+          uint16_t lastModifiedDate;
+          uint32_t crc32;
+          uint32_t compressedSize;
+          uint32_t uncompressedSize;
+          uint16_t filenameLength;
+          uint16_t extraFieldLength;
+          uint16_t fileCommentLength;
+          uint16_t diskNumberStart;
+          uint16_t internalFileAttributes;
+          uint32_t externalFileAttributes;
+          uint32_t localHeaderOffset;
+        };
+
+        struct EndOfCentralDirectoryRecord {
+          uint32_t signature;
+          uint16_t diskNumber;
+          uint16_t directoryDiskNumber;
+          uint16_t entryCountThisDisk;
+          uint16_t entryCountTotal;
+          uint32_t centralDirectorySize;
+          uint32_t centralDirectoryOffset;
+          uint16_t zipFileCommentLength;
+        };
+
+        struct Zip64EndOfCentralDirectoryLocator {
+          uint32_t signature;
+          uint32_t directoryDiskNumber;
+          uint64_t endOfCentralDirectoryOffset;
+          uint32_t diskCount;
+        };
+
+        struct Zip64EndOfCentralDirectoryRecord {
+          uint32_t signature;
+          uint64_t recordSize;
+          uint16_t versionCreated;
+          uint16_t versionNeeded;
+          uint32_t diskNumber;
+          uint32_t directoryDiskNumber;
+          uint64_t entryCountThisDisk;
+          uint64_t entryCountTotal;
+          uint64_t centralDirectorySize;
+          uint64_t centralDirectoryOffset;
+        };
+#pragma pack()
+
+        // where the central directory is stored and how many entries it holds
+        struct CentralDirectoryLocation {
+          uint64_t entryCount;
+          uint64_t size;
+          uint64_t offset;
+          // ZIP64 archives keep the real values in a separate record at this offset
+          bool hasZip64Record;
+          uint64_t zip64RecordOffset;
+        };
+
+        // an entry as described by its central directory record, with sizes
+        // and offset taken from the ZIP64 extra field where necessary
+        struct EntryInfo {
+          CentralDirectoryRecord record;
+          // not null-terminated, points into the central directory data
+          const char* filename;
+          uint16_t filenameLength;
+          uint64_t compressedSize;
+          uint64_t uncompressedSize;
+          uint64_t localHeaderOffset;
+        };
+
+        // Find the end of central directory record in the last tailLength bytes
+        // of an archive. If the archive has a ZIP64 locator in front of it, the
+        // location of the ZIP64 record is returned as well.
+        bool readEndOfCentralDirectory(
+          const uint8_t* tail,
+          size_t tailLength,
+          CentralDirectoryLocation* location
+          );
+
+        // Take entry count, size and offset of the central directory from a
+        // ZIP64 end of central directory record.
+        bool readZip64EndOfCentralDirectory(
+          const uint8_t* data,
+          size_t length,
+          CentralDirectoryLocation* location
+          );
+
+        // Parse the central directory record at *record, which is advanced to
+        // the next record. Returns false if the record is malformed.
+        bool readCentralDirectoryEntry(
+          const uint8_t** record,
+          const uint8_t* recordsEnd,
+          EntryInfo* entry
+          );
+
+        // Check the signature of the local header at data.
+        bool readLocalHeader(
+          const uint8_t* data,
+          size_t length,
+          LocalFileHeader* header
+          );
+      }
+    }
+  }
+}
@@ -0,0 +1,320 @@
+#include <string.h>
+
+#include <stdexcept>
+
+#include "crc32.h"
+#include "zipwriter.h"
+
+using namespace runtime::doo::zip::core;
+
+// version 2.0 is needed for deflate and data descriptors, 4.5 for ZIP64
+#define ZIP_VERSION_DEFAULT 20
+#define ZIP_VERSION_ZIP64 45
+// made by MS-DOS compatible software, so external attributes are DOS attributes
+#define ZIP_VERSION_CREATED ZIP_VERSION_ZIP64
+#define ZIP_DOS_ATTRIBUTE_DIRECTORY 0x10
+
+ZipWriter::ZipWriter(const OutputSink& writeOutput) :
+  writeOutput(writeOutput),
+  offset(0),
+  finished(false),
+  compressionThreadCount(1),
+  entryOpen(false),
+  entryDeflated(false),
+  entryZip64(false),
+  entryCrc(0),
+  entryCompressedSize(0),
+  entryUncompressedSize(0) {
+}
+
+ZipWriter::~ZipWriter() {
+}
+
+void ZipWriter::Write(const void* data, size_t length) {
+  if (length > 0) {
+    writeOutput(static_cast<const uint8_t*>(data), length);
+    offset += length;
+  }
+}
+
+void ZipWriter::SetCompressionThreadCount(unsigned int threadCount) {
+  if (entryOpen) {
+    throw std::logic_error("Can't change the compression threads while an entry is open");
+  }
+  if (threadCount != compressionThreadCount) {
+    parallelDeflater.reset();
+  }
+  compressionThreadCount = threadCount;
+}
+
+// deflate entry data with whichever compressor the entry was opened with
+void ZipWriter::Compress(const uint8_t* data, size_t length, DeflateFlush flush) {
+  uint64_t start = offset;
+  OutputSink writeCompressed = [this](const uint8_t* output, size_t outputLength) {
+    Write(output, outputLength);
+  };
+  if (deflater) {
+    deflater->Deflate(data, length, flush, writeCompressed);
+  } else {
+    parallelDeflater->Deflate(data, length, flush, writeCompressed);
+  }
+  entryCompressedSize += offset - start;
+}
+
+/************************************************************************/
+/* Write the local header of a new entry. CRC-32 and sizes aren't known */
+/* yet, they are left at 0 and flag bit 3 points to the data descriptor */
+/* written by CloseEntry(). The descriptor can only have 64 bit sizes   */
+/* if the local header has a ZIP64 extra field, which has to be decided */
+/* up front: entries that may reach 4 GB, allowing for the few bytes    */
+/* deflate adds to incompressible data, get one with zero sizes and the */
+/* 32 bit sizes set to the ZIP64 marker.                                */
+/************************************************************************/
+void ZipWriter::OpenEntry(const char* filename,
+                          size_t filenameLength,
+                          int level,
+                          uint16_t lastModifiedTime,
+                          uint16_t lastModifiedDate,
+                          uint64_t expectedSize) {
+  if (finished) {
+    throw std::logic_error("The ZIP archive is already finished");
+  }
+  if (filenameLength == 0 || filenameLength > UINT16_MAX) {
+    throw std::logic_error("Invalid filename length");
+  }
+  if (level != ZIP_STORE_LEVEL && (level < DEFLATE_MIN_LEVEL || level > DEFLATE_MAX_LEVEL)) {
+    throw std::logic_error("Invalid compression level");
+  }
+  if (entryOpen) {
+    CloseEntry();
+  }
+
+  bool isDirectory = filename[filenameLength - 1] == '/';
+  bool isAscii = true;
+  for (size_t i = 0; i < filenameLength; i++) {
+    if (static_cast<uint8_t>(filename[i]) >= 0x80) {
+      isAscii = false;
+      break;
+    }
+  }
+
+  // ZIP_SIZE_UNKNOWN is beyond the marker as well
+  bool zip64 = expectedSize >= ZipArchive_ZIP64_MARKER ||
+    expectedSize + expectedSize / 1024 + 1024 >= ZipArchive_ZIP64_MARKER;
+
+  WrittenEntry entry;
+  memset(&entry.record, 0, sizeof(entry.record));
+  entry.record.signature = ZipArchive_CENTRAL_DIRECTORY_RECORD_SIGNATURE;
+  entry.record.versionCreated = ZIP_VERSION_CREATED;
+  entry.record.versionNeeded = static_cast<uint16_t>(zip64 ? ZIP_VERSION_ZIP64 : ZIP_VERSION_DEFAULT);
+  entry.record.flags = static_cast<uint16_t>(
+    ZipArchive_FLAG_DATA_DESCRIPTOR | (isAscii ? 0 : ZipArchive_FLAG_UTF8));
+  // directories have no contents worth compressing
+  entry.record.compressionMethod = static_cast<uint16_t>(level == ZIP_STORE_LEVEL || isDirectory ? 0 : 8);
+  entry.record.lastModifiedTime = lastModifiedTime;
+  entry.record.lastModifiedDate = lastModifiedDate;
+  entry.record.filenameLength = static_cast<uint16_t>(filenameLength);
+  entry.record.externalFileAttributes = isDirectory ? ZIP_DOS_ATTRIBUTE_DIRECTORY : 0;
+  entry.filename.assign(filename, filenameLength);
+  entry.compressedSize = 0;
+  entry.uncompressedSize = 0;
+  entry.localHeaderOffset = offset;
+
+  LocalFileHeader localHeader;
+  memset(&localHeader, 0, sizeof(localHeader));
+  localHeader.signature = ZipArchive_ENTRY_LOCAL_HEADER_SIGNATURE;
+  localHeader.version = entry.record.versionNeeded;
+  localHeader.flags = entry.record.flags;
+  localHeader.compressionMethod = entry.record.compressionMethod;
+  localHeader.lastModifiedTime = lastModifiedTime;
+  localHeader.lastModifiedDate = lastModifiedDate;
+  localHeader.filenameLength = entry.record.filenameLength;
+  uint8_t extraField[4 + 2 * sizeof(uint64_t)];
+  if (zip64) {
+    localHeader.compressedSize = ZipArchive_ZIP64_MARKER;
+    localHeader.uncompressedSize = ZipArchive_ZIP64_MARKER;
+    localHeader.extraFieldLength = sizeof(extraField);
+    uint16_t headerId = ZipArchive_ZIP64_EXTRA_FIELD_ID;
+    uint16_t dataSize = sizeof(extraField) - 4;
+    memset(extraField, 0, sizeof(extraField));
+    memcpy(extraField, &headerId, 2);
+    memcpy(extraField + 2, &dataSize, 2);
+  }
+  Write(&localHeader, sizeof(localHeader));
+  Write(filename, filenameLength);
+  if (zip64) {
+    Write(extraField, sizeof(extraField));
+  }
+
+  entries.push_back(entry);
+  entryDeflated = entry.record.compressionMethod == 8;
+  entryZip64 = zip64;
+  if (entryDeflated) {
+    if (compressionThreadCount == 1) {
+      deflater.reset(new Deflater(level));
+    } else if (parallelDeflater) {
+      parallelDeflater->Reset(level);
+    } else {
+      parallelDeflater.reset(new ParallelDeflater(level, compressionThreadCount));
+    }
+  }
+  entryOpen = true;
+  entryCrc = 0;
+  entryCompressedSize = 0;
+  entryUncompressedSize = 0;
+}
+
+void ZipWriter::WriteEntryData(const uint8_t* data, size_t length) {
+  if (!entryOpen) {
+    throw std::logic_error("No ZIP entry is open");
+  }
+  if (length == 0) {
+    return;
+  }
+  if (entryDeflated) {
+    Compress(data, length, DEFLATE_NO_FLUSH);
+  } else {
+    if (entries.back().record.externalFileAttributes & ZIP_DOS_ATTRIBUTE_DIRECTORY) {
+      throw std::logic_error("Directory entries can't have contents");
+    }
+    entryCrc = updateCrc32(entryCrc, data, length);
+    Write(data, length);
+    entryCompressedSize += length;
+  }
+  entryUncompressedSize += length;
+}
+
+/************************************************************************/
+/* Finish the entry's data and write its data descriptor. The sizes in  */
+/* the descriptor take 8 bytes if the local header announced ZIP64.     */
+/************************************************************************/
+void ZipWriter::CloseEntry() {
+  if (!entryOpen) {
+    return;
+  }
+  if (entryDeflated) {
+    Compress(nullptr, 0, DEFLATE_FINISH);
+    entryCrc = deflater ? deflater->Crc32() : parallelDeflater->Crc32();
+    deflater.reset();
+  }
+  entryOpen = false;
+
+  WrittenEntry& entry = entries.back();
+  entry.record.crc32 = entryCrc;
+  entry.compressedSize = entryCompressedSize;
+  entry.uncompressedSize = entryUncompressedSize;
+
+  if (!entryZip64 &&
+      (entryCompressedSize >= ZipArchive_ZIP64_MARKER || entryUncompressedSize >= ZipArchive_ZIP64_MARKER)) {
+    throw std::logic_error("The entry outgrew the size it was opened with");
+  }
+  uint8_t descriptor[24];
+  uint32_t signature = ZipArchive_DATA_DESCRIPTOR_SIGNATURE;
+  memcpy(descriptor, &signature, 4);
+  memcpy(descriptor + 4, &entryCrc, 4);
+  if (entryZip64) {
+    memcpy(descriptor + 8, &entryCompressedSize, 8);
+    memcpy(descriptor + 16, &entryUncompressedSize, 8);
+    Write(descriptor, 24);
+  } else {
+    uint32_t compressedSize = static_cast<uint32_t>(entryCompressedSize);
+    uint32_t uncompressedSize = static_cast<uint32_t>(entryUncompressedSize);
+    memcpy(descriptor + 8, &compressedSize, 4);
+    memcpy(descriptor + 12, &uncompressedSize, 4);
+    Write(descriptor, 16);
+  }
+}
+
+/************************************************************************/
+/* Write a central directory record. Values that don't fit their 32 bit */
+/* fields are set to the ZIP64 marker and stored in the ZIP64 extra     */
+/* field instead, in the order the format prescribes.                   */
+/************************************************************************/
+void ZipWriter::WriteCentralDirectoryRecord(const WrittenEntry& entry) {
+  CentralDirectoryRecord record = entry.record;
+  uint8_t extraField[4 + 3 * sizeof(uint64_t)];
+  uint16_t extraLength = 4;
+  const uint64_t values[] = { entry.uncompressedSize, entry.compressedSize, entry.localHeaderOffset };
+  uint32_t fields[3];
+  for (int i = 0; i < 3; i++) {
+    if (values[i] >= ZipArchive_ZIP64_MARKER) {
+      fields[i] = ZipArchive_ZIP64_MARKER;
+      memcpy(extraField + extraLength, &values[i], sizeof(uint64_t));
+      extraLength += sizeof(uint64_t);
+    } else {
+      fields[i] = static_cast<uint32_t>(values[i]);
+    }
+  }
+  record.uncompressedSize = fields[0];
+  record.compressedSize = fields[1];
+  record.localHeaderOffset = fields[2];
+  if (extraLength > 4) {
+    uint16_t headerId = ZipArchive_ZIP64_EXTRA_FIELD_ID;
+    uint16_t dataSize = extraLength - 4;
+    memcpy(extraField, &headerId, 2);
+    memcpy(extraField + 2, &dataSize, 2);
+    record.extraFieldLength = extraLength;
+    record.versionNeeded = ZIP_VERSION_ZIP64;
+  }
+  Write(&record, sizeof(record));
+  Write(entry.filename.data(), entry.filename.size());
+  if (extraLength > 4) {
+    Write(extraField, extraLength);
+  }
+}
+
+/************************************************************************/
+/* Write the central directory and the end of central directory record, */
+/* preceded by the ZIP64 record and locator if the archive needs them.  */
+/************************************************************************/
+void ZipWriter::Finish() {
+  if (finished) {
+    return;
+  }
+  CloseEntry();
+
+  uint64_t directoryOffset = offset;
+  for (size_t i = 0; i < entries.size(); i++) {
+    WriteCentralDirectoryRecord(entries[i]);
+  }
+  uint64_t directorySize = offset - directoryOffset;
+  uint64_t entryCount = entries.size();
+
+  bool zip64 = entryCount >= UINT16_MAX ||
+    directorySize >= ZipArchive_ZIP64_MARKER ||
+    directoryOffset >= ZipArchive_ZIP64_MARKER;
+  if (zip64) {
+    uint64_t zip64RecordOffset = offset;
+    Zip64EndOfCentralDirectoryRecord zip64Record;
+    memset(&zip64Record, 0, sizeof(zip64Record));
+    zip64Record.signature = ZipArchive_ZIP64_END_OF_CENTRAL_RECORD_SIGNATURE;
+    // size of the record without the signature and the size field itself
+    zip64Record.recordSize = sizeof(zip64Record) - 12;
+    zip64Record.versionCreated = ZIP_VERSION_CREATED;
+    zip64Record.versionNeeded = ZIP_VERSION_ZIP64;
+    zip64Record.entryCountThisDisk = entryCount;
+    zip64Record.entryCountTotal = entryCount;
+    zip64Record.centralDirectorySize = directorySize;
+    zip64Record.centralDirectoryOffset = directoryOffset;
+    Write(&zip64Record, sizeof(zip64Record));
+
+    Zip64EndOfCentralDirectoryLocator locator;
+    memset(&locator, 0, sizeof(locator));
+    locator.signature = ZipArchive_ZIP64_END_OF_CENTRAL_LOCATOR_SIGNATURE;
+    locator.endOfCentralDirectoryOffset = zip64RecordOffset;
+    locator.diskCount = 1;
+    Write(&locator, sizeof(locator));
+  }
+
+  EndOfCentralDirectoryRecord record;
+  memset(&record, 0, sizeof(record));
+  record.signature = ZipArchive_END_OF_CENTRAL_RECORD_SIGNATURE;
+  record.entryCountThisDisk = static_cast<uint16_t>(entryCount >= UINT16_MAX ? UINT16_MAX : entryCount);
+  record.entryCountTotal = record.entryCountThisDisk;
+  record.centralDirectorySize = static_cast<uint32_t>(
+    directorySize >= ZipArchive_ZIP64_MARKER ? ZipArchive_ZIP64_MARKER : directorySize);
+  record.centralDirectoryOffset = static_cast<uint32_t>(
+    directoryOffset >= ZipArchive_ZIP64_MARKER ? ZipArchive_ZIP64_MARKER : directoryOffset);
+  Write(&record, sizeof(record));
+  finished = true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "deflate.h"
+#include "paralleldeflate.h"
+#include "zipformat.h"
+
+namespace runtime {
+  namespace doo {
+    namespace zip {
+      namespace core {
+        // compression level that stores entries without compressing them
+        const int ZIP_STORE_LEVEL = 0;
+        // size of an entry whose length isn't known before it is written
+        const uint64_t ZIP_SIZE_UNKNOWN = UINT64_MAX;
+
+        /************************************************************************/
+        /* Writes a ZIP archive front to back into an output sink. Entries are  */
+        /* streamed: the local header goes out before the data, CRC-32 and      */
+        /* sizes follow in a data descriptor, so nothing needs to be seeked     */
+        /* back to. ZIP64 records are added where sizes, offsets or the entry   */
+        /* count outgrow the 32 and 16 bit fields. Errors are reported as       */
+        /* std::logic_error, errors of the sink are passed on as they are.      */
+        /************************************************************************/
+        class ZipWriter {
+        public:
+          explicit ZipWriter(const OutputSink& writeOutput);
+          ~ZipWriter();
+
+          // Start a new entry with a UTF-8 filename. Level ZIP_STORE_LEVEL stores
+          // the data, DEFLATE_MIN_LEVEL to DEFLATE_MAX_LEVEL deflate it. Time and
+          // date are in MS-DOS format. Entries whose expected size is unknown or
+          // close to 4 GB get ZIP64 sizes, CloseEntry() fails if an entry
+          // outgrows the 32 bit sizes it was opened with.
+          void OpenEntry(
+            const char* filename,
+            size_t filenameLength,
+            int level,
+            uint16_t lastModifiedTime,
+            uint16_t lastModifiedDate,
+            uint64_t expectedSize
+            );
+          void WriteEntryData(const uint8_t* data, size_t length);
+          void CloseEntry();
+
+          // close the open entry, if any, and write the central directory
+          void Finish();
+
+          uint64_t BytesWritten() const { return offset; }
+
+          // Threads used to deflate the following entries, can't be changed
+          // while an entry is open. 1 compresses on the calling thread, more
+          // split entries into blocks that are compressed in parallel, 0 uses
+          // one thread per core.
+          void SetCompressionThreadCount(unsigned int threadCount);
+
+        private:
+          ZipWriter(const ZipWriter&);
+          ZipWriter& operator=(const ZipWriter&);
+
+          // what the central directory needs to know about a written entry
+          struct WrittenEntry {
+            CentralDirectoryRecord record;
+            std::string filename;
+            uint64_t compressedSize;
+            uint64_t uncompressedSize;
+            uint64_t localHeaderOffset;
+          };
+
+          void Write(const void* data, size_t length);
+          void Compress(const uint8_t* data, size_t length, DeflateFlush flush);
+          void WriteCentralDirectoryRecord(const WrittenEntry& entry);
+
+          OutputSink writeOutput;
+          uint64_t offset;
+          std::vector<WrittenEntry> entries;
+          bool finished;
+
+          unsigned int compressionThreadCount;
+          // kept across entries, so its workers are only started once
+          std::unique_ptr<ParallelDeflater> parallelDeflater;
+
+          // the entry currently being written
+          bool entryOpen;
+          bool entryDeflated;
+          // the local header has a ZIP64 extra field, the descriptor 64 bit sizes
+          bool entryZip64;
+          std::unique_ptr<Deflater> deflater;
+          uint32_t entryCrc;
+          uint64_t entryCompressedSize;
+          uint64_t entryUncompressedSize;
+        };
+      }
+    }
+  }
+}
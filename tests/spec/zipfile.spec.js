@@ -3,7 +3,10 @@
 
   var CreationCollisionOption = Windows.Storage.CreationCollisionOption,
       RandomAccessStreamReference = Windows.Storage.Streams.RandomAccessStreamReference,
-      ZipArchive = runtime.doo.zip.ZipArchive;
+      ZipArchive = runtime.doo.zip.ZipArchive,
+      ZipArchiveWriter = runtime.doo.zip.ZipArchiveWriter,
+      ZipArchiveOpenMode = runtime.doo.zip.ZipArchiveOpenMode,
+      ZipArchiveExtractMode = runtime.doo.zip.ZipArchiveExtractMode;
 
   describe('Zip component', function() {
 
@@ -39,6 +42,264 @@
       });
     });
 
+    it('should handle ZIP64 archives', function() {
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            BinaryStringEncoding = Windows.Security.Cryptography.BinaryStringEncoding,
+            stream, uri, archive;
+        // entry count, sizes and offsets are all taken from the ZIP64 records
+        uri = "resource/zip64.zip".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          expect(archive.files.length).toEqual(2);
+          expect(archive.files[1].uncompressedSize).toEqual(9690);
+          expect(archive.files[1].compressedSize).toEqual(545);
+          return archive.getFileContentsAsync('stored.txt');
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer))
+            .toEqual('This entry is stored in a ZIP64 archive.\n');
+          return archive.getFileContentsAsync('folder/deflated.txt');
+        }).then(function(buffer) {
+          var text = CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer);
+          expect(text.length).toEqual(9690);
+          return expect(text.indexOf('Line 199 of a deflated entry in a ZIP64 archive.\n')).toEqual(9690 - 49);
+        });
+      });
+    });
+
+    it('should read files from archives opened with only the central directory', function() {
+      return spec.async(function() {
+        var stream, uri;
+        uri = "resource/test1.odt".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream, ZipArchiveOpenMode.centralDirectoryOnly).then(function(archive) {
+          expect(archive.files.length).toEqual(17);
+          return archive.getFileContentsAsync('meta.xml');
+        }).then(function(buffer) {
+          return expect(buffer).toBeTruthy();
+        });
+      });
+    });
+
+    it('should look up files case insensitively if asked to', function() {
+      return spec.async(function() {
+        var stream, uri;
+        uri = "resource/test1.docx".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(archive) {
+          return archive.getFileContentsAsync('DOCPROPS/Core.xml').then(function(buffer) {
+            expect(buffer).toBeFalsy();
+            archive.ignoreCase = true;
+            return archive.getFileContentsAsync('DOCPROPS/Core.xml');
+          });
+        }).then(function(buffer) {
+          return expect(buffer).toBeTruthy();
+        });
+      });
+    });
+
+    it('should list the entries in a folder', function() {
+      return spec.async(function() {
+        var stream, uri;
+        uri = "resource/test1.odt".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(archive) {
+          var entries = archive.getEntriesInFolder('Configurations2', false);
+          expect(entries.length).toEqual(7);
+          expect(entries[0].filename).toEqual('Configurations2/floater/');
+          expect(archive.getEntriesInFolder('Configurations2/', true).length).toEqual(9);
+          expect(archive.getEntriesInFolder('', false).length).toEqual(6);
+          return expect(archive.getEntriesInFolder('missing', true).length).toEqual(0);
+        });
+      });
+    });
+
+    it('should find entries by pattern', function() {
+      return spec.async(function() {
+        var stream, uri;
+        uri = "resource/test1.docx".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(archive) {
+          expect(archive.findEntries('word/*.xml').length).toEqual(4);
+          expect(archive.findEntries('**/*.rels').length).toEqual(2);
+          expect(archive.findEntries('WORD/*.XML').length).toEqual(0);
+          archive.ignoreCase = true;
+          return expect(archive.findEntries('WORD/*.XML').length).toEqual(4);
+        });
+      });
+    });
+
+    it('should keep entries that only differ in case when ignoring case', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            BinaryStringEncoding = Windows.Security.Cryptography.BinaryStringEncoding,
+            zipFile;
+        return tempFolder.createFileAsync('cases.zip', CreationCollisionOption.replaceExisting).then(function(file) {
+          zipFile = file;
+          return ZipArchiveWriter.createForFileAsync(file);
+        }).then(function(writer) {
+          var buffer = CryptographicBuffer.convertStringToBinary('contents', BinaryStringEncoding.utf8);
+          return writer.addFileFromBufferAsync('Notes/A.txt', buffer).then(function() {
+            return writer.addFileFromBufferAsync('notes/a.txt', buffer);
+          }).then(function() {
+            return writer.addFileFromBufferAsync('notes/b.md', buffer);
+          }).then(function() {
+            return writer.closeAsync();
+          });
+        }).then(function() {
+          return ZipArchive.createFromFileAsync(zipFile);
+        }).then(function(archive) {
+          archive.ignoreCase = true;
+          expect(archive.getEntriesInFolder('NOTES', false).length).toEqual(3);
+          expect(archive.findEntries('notes/?.TXT').length).toEqual(2);
+          return expect(archive.findEntries('notes/a.txt')[0].filename).toEqual('Notes/A.txt');
+        });
+      });
+    });
+
+    it('should read ranges of files', function() {
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            stream, uri, archive, contents;
+        uri = "resource/test1.odt".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          archive.checkpointSpacing = 1024;
+          return archive.getFileContentsAsync('content.xml');
+        }).then(function(buffer) {
+          contents = CryptographicBuffer.encodeToHexString(buffer);
+          return archive.getFileRangeAsync('content.xml', 100, 200);
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.encodeToHexString(buffer)).toEqual(contents.substr(200, 400));
+          return archive.getFileRangeAsync('content.xml', contents.length / 2 - 10, 200);
+        }).then(function(buffer) {
+          return expect(buffer.length).toEqual(10);
+        });
+      });
+    });
+
+    it('should stream files while they are inflated', function() {
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            stream, uri, archive, contents;
+        uri = "resource/test1.odt".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          return archive.getFileContentsAsync('content.xml');
+        }).then(function(buffer) {
+          contents = buffer;
+          return archive.openEntryStreamAsync('content.xml', 1024);
+        }).then(function(entryStream) {
+          var reader = new Windows.Storage.Streams.DataReader(entryStream);
+          return reader.loadAsync(contents.length).then(function(loaded) {
+            expect(loaded).toEqual(contents.length);
+            return expect(CryptographicBuffer.compare(reader.readBuffer(loaded), contents)).toBeTruthy();
+          });
+        });
+      });
+    });
+
+    it('should serve repeated reads from the cache', function() {
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            stream, uri, archive;
+        uri = "resource/test1.docx".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          archive.cacheSize = 1024 * 1024;
+          return WinJS.Promise.join([
+            archive.getFileContentsAsync('docProps/core.xml'),
+            archive.getFileContentsAsync('docProps/core.xml')
+          ]);
+        }).then(function(buffers) {
+          expect(CryptographicBuffer.compare(buffers[0], buffers[1])).toBeTruthy();
+          // the reads above may both have missed, this one has to be a hit
+          archive.resetStatistics();
+          return archive.getFileContentsAsync('docProps/core.xml').then(function(buffer) {
+            var statistics = archive.getStatistics();
+            expect(statistics.cacheHits).toEqual(1);
+            expect(statistics.cacheMisses).toEqual(0);
+            expect(statistics.bytesInflated).toEqual(0);
+            return expect(CryptographicBuffer.compare(buffer, buffers[0])).toBeTruthy();
+          });
+        });
+      });
+    });
+
+    it('should count reads and trace operations on entries', function() {
+      return spec.async(function() {
+        var stream, uri, archive, traces = [];
+        uri = "resource/test1.docx".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          archive.entryTraceHandler = function(trace) {
+            traces.push(trace);
+          };
+          archive.cacheSize = 1024 * 1024;
+          return archive.getFileContentsAsync('docProps/core.xml');
+        }).then(function(buffer) {
+          return archive.getFileContentsAsync('docProps/core.xml').then(function() {
+            var statistics = archive.getStatistics();
+            expect(statistics.readCount).toBeGreaterThan(0);
+            expect(statistics.bytesInflated).toEqual(buffer.length);
+            expect(statistics.cacheHits).toEqual(1);
+            expect(statistics.cacheMisses).toEqual(1);
+            expect(traces.length).toEqual(1);
+            expect(traces[0].filename).toEqual('docProps/core.xml');
+            expect(traces[0].bytesInflated).toEqual(buffer.length);
+            archive.resetStatistics();
+            return expect(archive.getStatistics().bytesRead).toEqual(0);
+          });
+        });
+      });
+    });
+
+    it('should reopen archives from a saved directory index', function() {
+      return spec.async(function() {
+        var uri, directoryIndex;
+        uri = "resource/test1.odt".toAppPackageUri();
+        return ZipArchive.createFromStreamReferenceAsync(RandomAccessStreamReference.createFromUri(uri)).then(function(archive) {
+          expect(archive.directoryIndexUsed).toBeFalsy();
+          directoryIndex = archive.saveDirectoryIndex();
+          return ZipArchive.createFromStreamReferenceAsync(RandomAccessStreamReference.createFromUri(uri),
+            ZipArchiveOpenMode.validateLocalHeaders, directoryIndex);
+        }).then(function(archive) {
+          expect(archive.directoryIndexUsed).toBeTruthy();
+          expect(archive.files.length).toEqual(17);
+          return archive.getFileContentsAsync('meta.xml');
+        }).then(function(buffer) {
+          return expect(buffer).toBeTruthy();
+        });
+      });
+    });
+
+    it('should read several files at once', function() {
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            stream, uri, archive, contents;
+        uri = "resource/test1.docx".toAppPackageUri();
+        stream = RandomAccessStreamReference.createFromUri(uri);
+        return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+          archive = result;
+          return archive.getFilesContentsAsync(['docProps/core.xml', 'missing.xml', '[Content_Types].xml']);
+        }).then(function(buffers) {
+          contents = buffers;
+          expect(contents.length).toEqual(3);
+          expect(contents[1]).toBeFalsy();
+          return archive.getFileContentsAsync('[Content_Types].xml');
+        }).then(function(buffer) {
+          return expect(CryptographicBuffer.compare(buffer, contents[2])).toBeTruthy();
+        });
+      });
+    });
+
     it('should extract single files to disk', function () {
       var tempFolder;
       tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
@@ -90,6 +351,182 @@
       });
     });
 
+    it('should extract whole archives in a single sequential pass', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer;
+        return tempFolder.createFolderAsync('unzipped-sequential', CreationCollisionOption.replaceExisting).then(function(folder) {
+          var stream, uri, archive;
+          uri = "resource/test1.odt".toAppPackageUri();
+          stream = RandomAccessStreamReference.createFromUri(uri);
+          return ZipArchive.createFromStreamReferenceAsync(stream).then(function(result) {
+            archive = result;
+            return archive.extractAllAsync(folder, ZipArchiveExtractMode.sequentialRead);
+          }).then(function() {
+            // every file on disk has to match what a random access read gives
+            var files = Array.prototype.filter.call(archive.files, function(entry) {
+              return !entry.isDirectory;
+            });
+            return WinJS.Promise.join(files.map(function(entry) {
+              return WinJS.Promise.join([
+                archive.getFileContentsAsync(entry.filename),
+                folder.getFileAsync(entry.filename.replace(/\//g, '\\')).then(function(file) {
+                  return Windows.Storage.FileIO.readBufferAsync(file);
+                })
+              ]).then(function(buffers) {
+                return expect(CryptographicBuffer.compare(buffers[0], buffers[1])).toBeTruthy();
+              });
+            }));
+          });
+        });
+      });
+    });
+
+    it('should report progress while extracting', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        return tempFolder.createFolderAsync('unzipped-progress', CreationCollisionOption.replaceExisting).then(function(folder) {
+          var stream, uri, reports = [];
+          uri = "resource/test1.odt".toAppPackageUri();
+          stream = RandomAccessStreamReference.createFromUri(uri);
+          return ZipArchive.createFromStreamReferenceAsync(stream).then(function(archive) {
+            return archive.extractAllWithProgressAsync(folder).then(null, null, function(progress) {
+              reports.push(progress);
+            });
+          }).then(function() {
+            var last = reports[reports.length - 1];
+            expect(reports.length).toBeGreaterThan(1);
+            expect(last.bytesTotal).toBeGreaterThan(0);
+            return expect(last.bytesDone).toEqual(last.bytesTotal);
+          });
+        });
+      });
+    });
+
+    it('should write archives that can be read back', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            BinaryStringEncoding = Windows.Security.Cryptography.BinaryStringEncoding,
+            contents = new Array(1000).join('compressible text '),
+            zipFile, archive;
+        return tempFolder.createFileAsync('written.zip', CreationCollisionOption.replaceExisting).then(function(file) {
+          zipFile = file;
+          return ZipArchiveWriter.createForFileAsync(file);
+        }).then(function(writer) {
+          var buffer = CryptographicBuffer.convertStringToBinary(contents, BinaryStringEncoding.utf8);
+          return writer.addFileFromBufferAsync('deflated.txt', buffer).then(function() {
+            writer.compressionLevel = 0;
+            return writer.addFileFromBufferAsync('folder/stored.txt', buffer);
+          }).then(function() {
+            // streams have no known size and get ZIP64 local headers
+            var memoryStream = new Windows.Storage.Streams.InMemoryRandomAccessStream();
+            writer.compressionLevel = 6;
+            return memoryStream.writeAsync(buffer).then(function() {
+              return writer.addFileFromStreamAsync('streamed.txt', memoryStream.getInputStreamAt(0));
+            });
+          }).then(function() {
+            // stored as UTF-8 with the flag set
+            return writer.addFileFromBufferAsync('caf\u00e9/na\u00efve.txt', buffer);
+          }).then(function() {
+            return writer.closeAsync();
+          });
+        }).then(function() {
+          return ZipArchive.createFromFileAsync(zipFile);
+        }).then(function(result) {
+          archive = result;
+          expect(archive.files.length).toEqual(4);
+          expect(archive.files[3].filename).toEqual('caf\u00e9/na\u00efve.txt');
+          expect(archive.files[0].compressedSize).toBeLessThan(archive.files[0].uncompressedSize);
+          expect(archive.files[1].compressedSize).toEqual(archive.files[1].uncompressedSize);
+          return archive.getFileContentsAsync('deflated.txt');
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual(contents);
+          return archive.getFileContentsAsync('folder/stored.txt');
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual(contents);
+          return archive.getFileContentsAsync('streamed.txt');
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual(contents);
+          return archive.getFileContentsAsync('caf\u00e9/na\u00efve.txt');
+        }).then(function(buffer) {
+          return expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual(contents);
+        });
+      });
+    });
+
+    it('should deflate entries on several threads', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            BinaryStringEncoding = Windows.Security.Cryptography.BinaryStringEncoding,
+            lines = [],
+            contents, zipFile, i;
+        // about 1.1 MB, several of the blocks deflated in parallel
+        for (i = 0; i < 60000; i++) {
+          lines.push('line ' + i + ' of ' + (i * 7919 % 10007));
+        }
+        contents = lines.join('\n');
+        return tempFolder.createFileAsync('parallel.zip', CreationCollisionOption.replaceExisting).then(function(file) {
+          zipFile = file;
+          return ZipArchiveWriter.createForFileAsync(file);
+        }).then(function(writer) {
+          var buffer = CryptographicBuffer.convertStringToBinary(contents, BinaryStringEncoding.utf8);
+          writer.compressionThreadCount = 4;
+          return writer.addFileFromBufferAsync('parallel.txt', buffer).then(function() {
+            return writer.closeAsync();
+          });
+        }).then(function() {
+          return ZipArchive.createFromFileAsync(zipFile);
+        }).then(function(archive) {
+          expect(archive.files[0].uncompressedSize).toEqual(contents.length);
+          expect(archive.files[0].compressedSize).toBeLessThan(contents.length);
+          return archive.getFileContentsAsync('parallel.txt');
+        }).then(function(buffer) {
+          return expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual(contents);
+        });
+      });
+    });
+
+    it('should look up entries with non-ASCII filenames', function () {
+      var tempFolder;
+      tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;
+      return spec.async(function() {
+        var CryptographicBuffer = Windows.Security.Cryptography.CryptographicBuffer,
+            BinaryStringEncoding = Windows.Security.Cryptography.BinaryStringEncoding,
+            filename = 'Gr\u00fc\u00dfe/\u00c4rger.txt',
+            zipFile, archive;
+        return tempFolder.createFileAsync('nonascii.zip', CreationCollisionOption.replaceExisting).then(function(file) {
+          zipFile = file;
+          return ZipArchiveWriter.createForFileAsync(file);
+        }).then(function(writer) {
+          var buffer = CryptographicBuffer.convertStringToBinary('contents', BinaryStringEncoding.utf8);
+          return writer.addFileFromBufferAsync(filename, buffer).then(function() {
+            return writer.closeAsync();
+          });
+        }).then(function() {
+          return ZipArchive.createFromFileAsync(zipFile);
+        }).then(function(result) {
+          archive = result;
+          expect(archive.files[0].filename).toEqual(filename);
+          expect(archive.getEntriesInFolder('Gr\u00fc\u00dfe', false).length).toEqual(1);
+          expect(archive.findEntries('Gr\u00fc\u00dfe/*.txt').length).toEqual(1);
+          return archive.getFileContentsAsync(filename);
+        }).then(function(buffer) {
+          expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual('contents');
+          archive.ignoreCase = true;
+          // upper-cased by hand, toUpperCase() would turn the sharp s into SS
+          return archive.getFileContentsAsync('GR\u00dc\u00dfE/\u00c4RGER.TXT');
+        }).then(function(buffer) {
+          return expect(CryptographicBuffer.convertBinaryToString(BinaryStringEncoding.utf8, buffer)).toEqual('contents');
+        });
+      });
+    });
+
     return it('should throw invalid argument exception for non-existing files', function () {
       var tempFolder;
       tempFolder = Windows.Storage.ApplicationData.current.temporaryFolder;